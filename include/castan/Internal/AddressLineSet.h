@@ -0,0 +1,44 @@
+#ifndef CASTAN_INTERNAL_ADDRESSLINESET_H
+#define CASTAN_INTERNAL_ADDRESSLINESET_H
+
+#include <klee/Constraints.h>
+#include <klee/Expr.h>
+
+#include <set>
+
+namespace castan {
+// Over-approximates the cache lines, as offsets within a page, that a
+// symbolic address of the form base + scale * index can reach. The bounds on
+// index come only from its width and from the range comparisons in the path
+// constraints, so no solver is needed. When the address isn't affine in a
+// single index, or there are too many lines to enumerate, the set is unknown
+// and every line is reported as possible.
+class AddressLineSet {
+private:
+  unsigned blockBits, pageBits;
+  bool known = false;
+  // Page offsets of the reachable lines.
+  std::set<uint64_t> lines;
+
+  bool decompose(klee::ref<klee::Expr> e, uint64_t multiplier, uint64_t &base,
+                 uint64_t &scale, klee::ref<klee::Expr> &index);
+  void bound(const klee::ConstraintManager &constraints,
+             klee::ref<klee::Expr> index, uint64_t &min, uint64_t &max);
+
+public:
+  AddressLineSet(const klee::ConstraintManager &constraints,
+                 klee::ref<klee::Expr> address, unsigned blockBits,
+                 unsigned pageBits);
+
+  bool isKnown() const { return known; }
+  size_t size() const { return lines.size(); }
+
+  // Returns false only if no value of the address falls in the line at page
+  // offset line.
+  bool mayContain(uint64_t line) const {
+    return !known || lines.count(line);
+  }
+};
+}
+
+#endif
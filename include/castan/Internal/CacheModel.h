@@ -16,11 +16,23 @@ public:
                                       klee::ExecutionState &state,
                                       klee::ref<klee::Expr> address) = 0;
   virtual void exec(klee::ExecutionState &state) = 0;
+  // Whether the first loop iteration has started.
+  virtual bool isEnabled() = 0;
   virtual bool loop(klee::ExecutionState &state) = 0;
+  // Number of packets processed in the current loop iteration.
+  virtual void burst(klee::ExecutionState &state, unsigned packets) = 0;
 
   virtual double getTotalTime() = 0;
+  virtual double getIterationTime(int iteration) = 0;
   virtual int getNumIterations() = 0;
 
+  // Replay of a trace recorded natively, see tools/castan-validate.
+  // Starts a new loop iteration, regardless of --max-loops.
+  virtual void replayLoop() = 0;
+  virtual void replayAccess(uint64_t address, bool isWrite) = 0;
+  // Non-memory instructions, charged at the flat cost.
+  virtual void replayInstructions(unsigned long count) = 0;
+
   virtual std::string dumpStats() = 0;
 };
 }
@@ -25,10 +25,14 @@ typedef struct {
 
 typedef struct {
   unsigned long instructionCount;
+  // Time spent in non-memory instructions, in ns.
+  double instructionTime;
   unsigned long readCount;
   unsigned long writeCount;
   unsigned long hitCount;
   unsigned long missCount;
+  // Packets in the burst (0 if the NF doesn't report bursts).
+  unsigned long packetCount;
 } contentionset_loop_stats_t;
 
 namespace castan {
@@ -80,11 +84,18 @@ public:
     }
   }
   void exec(klee::ExecutionState &state);
+  bool isEnabled() { return enabled; }
   bool loop(klee::ExecutionState &state);
+  void burst(klee::ExecutionState &state, unsigned packets);
 
   double getTotalTime();
+  double getIterationTime(int iteration);
   int getNumIterations() { return loopStats.size(); }
 
+  void replayLoop();
+  void replayAccess(uint64_t address, bool isWrite);
+  void replayInstructions(unsigned long count);
+
   std::string dumpStats();
 };
 }
@@ -84,10 +84,14 @@ typedef struct {
 
 typedef struct {
   unsigned long instructionCount;
+  // Time spent in non-memory instructions, in ns.
+  double instructionTime;
   unsigned long readCount;
   unsigned long writeCount;
   // [level] -> # hits
   std::map<uint8_t, unsigned long> hitCount;
+  // Packets in the burst (0 if the NF doesn't report bursts).
+  unsigned long packetCount;
 } loop_stats_t;
 
 namespace castan {
@@ -142,11 +146,18 @@ public:
     }
   }
   void exec(klee::ExecutionState &state);
+  bool isEnabled() { return enabled; }
   bool loop(klee::ExecutionState &state);
+  void burst(klee::ExecutionState &state, unsigned packets);
 
   double getTotalTime();
+  double getIterationTime(int iteration);
   int getNumIterations() { return loopStats.size(); }
 
+  void replayLoop();
+  void replayAccess(uint64_t address, bool isWrite);
+  void replayInstructions(unsigned long count);
+
   std::string dumpStats();
 };
 }
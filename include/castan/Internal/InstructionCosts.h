@@ -0,0 +1,63 @@
+#ifndef CASTAN_INTERNAL_INSTRUCTIONCOSTS_H
+#define CASTAN_INTERNAL_INSTRUCTIONCOSTS_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class BasicBlock;
+class Instruction;
+}
+
+namespace castan {
+// Execution time of non-memory instructions, in ns, learned from hardware
+// measurements and loaded from the table given with --instruction-costs.
+// The table has one entry per line:
+//
+//   opcode <llvm-opcode-name> <ns>
+//   block <function> <block-index> <ns>
+//   overhead <ns>
+//
+// An opcode entry replaces the default per-instruction cost for that
+// opcode. A block entry is a residual charged on entry to the block, indexed
+// by its position in the function; scripts/perf/learn-instruction-costs.sh
+// only produces opcode and overhead entries, so block entries are for
+// residuals found by hand, e.g. from profiling a hot block. The overhead is
+// charged once per loop iteration. Lines starting with '#' are comments.
+class InstructionCosts {
+private:
+  bool loaded = false;
+  // [opcode] -> ns, negative if not in the table.
+  std::vector<double> opcodeCosts;
+  // [<function, block index>] -> ns
+  std::map<std::pair<std::string, unsigned>, double> blockCosts;
+  // Block residuals resolved so far.
+  std::map<const llvm::BasicBlock *, double> resolvedBlockCosts;
+  bool hasOverhead = false;
+  double overhead = 0;
+
+  double getBlockCost(const llvm::BasicBlock *bb);
+
+public:
+  void load(const std::string &fileName);
+
+  bool isLoaded() const { return loaded; }
+
+  // The cost of executing inst, given the cost of instructions the table
+  // does not cover.
+  double getCost(const llvm::Instruction *inst, double defaultCost);
+  // The mean cost of the opcodes in the table, for instructions that cannot
+  // be attributed to an opcode, such as those counted in native traces.
+  double getMeanCost(double defaultCost) const;
+  double getOverhead(double defaultOverhead) const {
+    return hasOverhead ? overhead : defaultOverhead;
+  }
+};
+
+// The table shared by all cache models, loaded on first use.
+InstructionCosts &getInstructionCosts();
+}
+
+#endif
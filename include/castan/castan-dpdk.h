@@ -1,6 +1,10 @@
 #undef __AVX__
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
 #include <castan/castan.h>
 #include <castan/emmintrin.h>
 #include <rte_eal_memconfig.h>
@@ -24,6 +28,179 @@ struct packet {
   };
 };
 
+// Symbolic packet template.
+// Controls the shape of the symbolic packets returned by rte_eth_rx_burst.
+// Every byte of the packet is symbolic unless pinned by a fixed field or by the
+// protocol constraints below. The template is normally loaded at startup from
+// a file (see castan_load_packet_template); NFs can also compile their own in
+// by defining it and building with -DCASTAN_PACKET_TEMPLATE=<variable name>.
+#define CASTAN_PROTO_UDP (1 << 0)
+#define CASTAN_PROTO_TCP (1 << 1)
+
+enum castan_packet_layer {
+  CASTAN_LAYER_L2, // Offset from the start of the Ethernet header.
+  CASTAN_LAYER_L3, // Offset from the start of the IPv4 header.
+  CASTAN_LAYER_L4, // Offset from the start of the TCP/UDP header.
+};
+
+struct castan_packet_field {
+  enum castan_packet_layer layer;
+  uint16_t offset;
+  uint8_t size;
+  // Value in network byte order.
+  uint8_t value[8];
+};
+
+struct castan_packet_template {
+  // Bitmask of allowed L4 protocols (CASTAN_PROTO_*).
+  uint8_t protocols;
+  // Whether packets may carry an 802.1Q tag.
+  uint8_t vlan;
+  // Maximum length of IPv4 options, in 32-bit words.
+  uint8_t max_ip_options;
+  // Frame size range, excluding the FCS.
+  uint16_t min_size;
+  uint16_t max_size;
+  // Fields with a fixed value.
+  const struct castan_packet_field *fixed_fields;
+  unsigned num_fixed_fields;
+};
+
+// Default: fixed-size Ethernet/IPv4/UDP packets with no payload.
+struct castan_packet_template __attribute__((weak))
+castan_default_packet_template = {
+    .protocols = CASTAN_PROTO_UDP,
+    .vlan = 0,
+    .max_ip_options = 0,
+    .min_size = sizeof(struct packet),
+    .max_size = sizeof(struct packet),
+    .fixed_fields = NULL,
+    .num_fixed_fields = 0,
+};
+
+#ifndef CASTAN_PACKET_TEMPLATE
+#define CASTAN_PACKET_TEMPLATE castan_default_packet_template
+#endif
+extern struct castan_packet_template CASTAN_PACKET_TEMPLATE;
+
+// The template in use: CASTAN_PACKET_TEMPLATE, unless one is loaded.
+const struct castan_packet_template __attribute__((weak))
+    *castan_active_packet_template = &CASTAN_PACKET_TEMPLATE;
+
+#ifndef CASTAN_MAX_FIXED_FIELDS
+#define CASTAN_MAX_FIXED_FIELDS 32
+#endif
+struct castan_packet_template __attribute__((weak))
+    castan_loaded_packet_template;
+struct castan_packet_field __attribute__((weak))
+    castan_loaded_fixed_fields[CASTAN_MAX_FIXED_FIELDS];
+
+void __attribute__((weak)) castan_template_error(int line) {
+  klee_report_error("CASTAN_PACKET_TEMPLATE_FILE", line,
+                    "Invalid packet template entry.", "template.err");
+}
+
+// Loads the template from the file named by the CASTAN_PACKET_TEMPLATE_FILE
+// environment variable, if set. The file holds one entry per line; entries
+// that are left out keep the value of CASTAN_PACKET_TEMPLATE:
+//
+//   protocols udp|tcp...            allowed L4 protocols
+//   vlan 0|1                        whether 802.1Q tags may appear
+//   max-ip-options <words>          maximum length of IPv4 options
+//   size <min> <max>                frame size range, excluding the FCS
+//   fixed l2|l3|l4 <offset> <hex byte>...
+//                                   a field with a fixed value, at an offset
+//                                   from the start of that layer's header
+//
+// Lines starting with '#' are comments. For example, UDP and TCP packets of
+// up to 128 bytes with a fixed destination address:
+//
+//   protocols udp tcp
+//   vlan 1
+//   max-ip-options 2
+//   size 64 128
+//   fixed l3 16 0a 00 00 01
+void __attribute__((weak)) castan_load_packet_template() {
+  const char *path = getenv("CASTAN_PACKET_TEMPLATE_FILE");
+  if (!path) {
+    return;
+  }
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    klee_report_error(__FILE__, __LINE__,
+                      "Unable to open CASTAN_PACKET_TEMPLATE_FILE.",
+                      "template.err");
+  }
+
+  struct castan_packet_template *t = &castan_loaded_packet_template;
+  *t = CASTAN_PACKET_TEMPLATE;
+  t->fixed_fields = castan_loaded_fixed_fields;
+  t->num_fixed_fields = 0;
+
+  char line[256];
+  for (int line_number = 1; fgets(line, sizeof(line), file); line_number++) {
+    char kind[32], word[32];
+    int length, position;
+    unsigned a, b;
+    if (sscanf(line, "%31s%n", kind, &position) != 1 || kind[0] == '#') {
+      continue;
+    }
+    const char *rest = line + position;
+
+    if (!strcmp(kind, "protocols")) {
+      t->protocols = 0;
+      for (; sscanf(rest, "%31s%n", word, &length) == 1; rest += length) {
+        if (!strcmp(word, "udp")) {
+          t->protocols |= CASTAN_PROTO_UDP;
+        } else if (!strcmp(word, "tcp")) {
+          t->protocols |= CASTAN_PROTO_TCP;
+        } else {
+          castan_template_error(line_number);
+        }
+      }
+    } else if (!strcmp(kind, "vlan") && sscanf(rest, "%u", &a) == 1) {
+      t->vlan = a != 0;
+    } else if (!strcmp(kind, "max-ip-options") &&
+               sscanf(rest, "%u", &a) == 1 && a <= 10) {
+      t->max_ip_options = a;
+    } else if (!strcmp(kind, "size") && sscanf(rest, "%u %u", &a, &b) == 2) {
+      t->min_size = a;
+      t->max_size = b;
+    } else if (!strcmp(kind, "fixed") &&
+               t->num_fixed_fields < CASTAN_MAX_FIXED_FIELDS &&
+               sscanf(rest, "%31s %u%n", word, &a, &length) == 2) {
+      struct castan_packet_field *f =
+          &castan_loaded_fixed_fields[t->num_fixed_fields++];
+      if (!strcmp(word, "l2")) {
+        f->layer = CASTAN_LAYER_L2;
+      } else if (!strcmp(word, "l3")) {
+        f->layer = CASTAN_LAYER_L3;
+      } else if (!strcmp(word, "l4")) {
+        f->layer = CASTAN_LAYER_L4;
+      } else {
+        castan_template_error(line_number);
+      }
+      f->offset = a;
+      f->size = 0;
+      for (rest += length; sscanf(rest, "%x%n", &b, &length) == 1;
+           rest += length) {
+        if (f->size == sizeof(f->value) || b > 0xff) {
+          castan_template_error(line_number);
+        }
+        f->value[f->size++] = b;
+      }
+      if (!f->size) {
+        castan_template_error(line_number);
+      }
+    } else {
+      castan_template_error(line_number);
+    }
+  }
+  fclose(file);
+
+  castan_active_packet_template = t;
+}
+
 struct rte_eth_dev __attribute__((weak)) rte_eth_devices[RTE_MAX_ETHPORTS];
 
 struct rte_mempool_ops_table __attribute__((weak))
@@ -33,6 +210,77 @@ __thread unsigned int __attribute__((weak)) per_lcore__lcore_id = 0;
 
 void __attribute__((weak)) castan_rte_prefetch(const volatile void *p) {}
 
+// Time model.
+// The clock only advances when packets arrive: each packet carries a symbolic
+// inter-arrival time (castan_time), and every clock source returns the
+// arrival time of the most recent packet. This keeps time monotone while
+// letting the search pick the arrival pattern that triggers expiry.
+// Time is kept in TSC ticks, so that rte_rdtsc, which NFs call on every
+// packet, involves no arithmetic; only the rarer wall-clock sources divide.
+// The TSC frequency is recorded once in the test case (castan_tsc_hz) for
+// ktest2pcap to convert back to ns.
+// Override the bounds with -DCASTAN_MAX_INTER_ARRIVAL_NS=<n> and the TSC
+// frequency with -DCASTAN_TSC_HZ=<n>.
+#ifndef CASTAN_MAX_INTER_ARRIVAL_NS
+#define CASTAN_MAX_INTER_ARRIVAL_NS 1000000000ull
+#endif
+#ifndef CASTAN_TSC_HZ
+#define CASTAN_TSC_HZ 3300000000ull
+#endif
+
+uint64_t __attribute__((weak)) castan_now_tsc = 0;
+int __attribute__((weak)) castan_tsc_hz_recorded = 0;
+
+void __attribute__((weak)) castan_advance_time() {
+  if (!castan_tsc_hz_recorded) {
+    uint64_t hz;
+    klee_make_symbolic(&hz, sizeof(hz), "castan_tsc_hz");
+    klee_assume(hz == CASTAN_TSC_HZ);
+    castan_tsc_hz_recorded = 1;
+  }
+
+  uint64_t delta;
+  klee_make_symbolic(&delta, sizeof(delta), "castan_time");
+  klee_assume(delta <= (uint64_t)((unsigned __int128)
+                                    CASTAN_MAX_INTER_ARRIVAL_NS *
+                                    CASTAN_TSC_HZ / 1000000000ull));
+  castan_now_tsc += delta;
+}
+
+uint64_t __attribute__((weak)) castan_rte_rdtsc() { return castan_now_tsc; }
+
+uint64_t __attribute__((weak)) castan_rte_get_tsc_hz() {
+  return CASTAN_TSC_HZ;
+}
+
+// The fraction of the current second, in units of 1 / scale s. The product
+// is taken in 128 bits, as it exceeds 64 bits for TSCs above ~18.4 GHz.
+static inline uint64_t castan_tsc_subsecond(uint64_t scale) {
+  return (unsigned __int128)(castan_now_tsc % CASTAN_TSC_HZ) * scale /
+         CASTAN_TSC_HZ;
+}
+
+time_t __attribute__((weak)) castan_time(time_t *t) {
+  time_t now = castan_now_tsc / CASTAN_TSC_HZ;
+  if (t) {
+    *t = now;
+  }
+  return now;
+}
+
+int __attribute__((weak)) castan_clock_gettime(clockid_t clk_id,
+                                               struct timespec *tp) {
+  tp->tv_sec = castan_now_tsc / CASTAN_TSC_HZ;
+  tp->tv_nsec = castan_tsc_subsecond(1000000000);
+  return 0;
+}
+
+int __attribute__((weak)) castan_gettimeofday(struct timeval *tv, void *tz) {
+  tv->tv_sec = castan_now_tsc / CASTAN_TSC_HZ;
+  tv->tv_usec = castan_tsc_subsecond(1000000);
+  return 0;
+}
+
 int rte_eal_tailqs_init(void);
 int __attribute__((weak)) rte_eal_init(int argc, char **argv) {
   klee_alias_function("rte_memzone_reserve", "castan_rte_memzone_reserve");
@@ -40,10 +288,21 @@ int __attribute__((weak)) rte_eal_init(int argc, char **argv) {
   klee_alias_function("rte_prefetch1", "castan_rte_prefetch");
   klee_alias_function("rte_prefetch2", "castan_rte_prefetch");
   klee_alias_function("rte_prefetch_non_temporal", "castan_rte_prefetch");
+  klee_alias_function("rte_rdtsc", "castan_rte_rdtsc");
+  klee_alias_function("rte_rdtsc_precise", "castan_rte_rdtsc");
+  klee_alias_function("rte_get_tsc_cycles", "castan_rte_rdtsc");
+  klee_alias_function("rte_get_timer_cycles", "castan_rte_rdtsc");
+  klee_alias_function("rte_get_tsc_hz", "castan_rte_get_tsc_hz");
+  klee_alias_function("rte_get_timer_hz", "castan_rte_get_tsc_hz");
+  klee_alias_function("time", "castan_time");
+  klee_alias_function("clock_gettime", "castan_clock_gettime");
+  klee_alias_function("gettimeofday", "castan_gettimeofday");
 
   if (rte_eal_tailqs_init() < 0)
     rte_panic("Cannot init tail queues for objects\n");
 
+  castan_load_packet_template();
+
   return 0;
 }
 
@@ -96,7 +355,22 @@ struct rte_memzone __attribute__((weak)) *
   return mz;
 }
 
-uint8_t __attribute__((weak)) rte_eth_dev_count() { return 2; }
+// Number of ports reported by rte_eth_dev_count.
+// Override with -DCASTAN_NUM_PORTS=<n>.
+#ifndef CASTAN_NUM_PORTS
+#define CASTAN_NUM_PORTS 2
+#endif
+
+// Size of the modelled TX descriptor ring of each port and queue.
+#ifndef CASTAN_TX_RING_SIZE
+#define CASTAN_TX_RING_SIZE 512
+#endif
+
+// Queues configured by the NF on each port.
+uint16_t __attribute__((weak)) castan_nb_rx_queues[RTE_MAX_ETHPORTS];
+uint16_t __attribute__((weak)) castan_nb_tx_queues[RTE_MAX_ETHPORTS];
+
+uint8_t __attribute__((weak)) rte_eth_dev_count() { return CASTAN_NUM_PORTS; }
 
 void __attribute__((weak))
 rte_eth_macaddr_get(uint8_t port_id, struct ether_addr *mac_addr) {
@@ -133,6 +407,8 @@ int __attribute__((weak))
 rte_eth_dev_configure(uint8_t port_id, uint16_t nb_rx_queue,
                       uint16_t nb_tx_queue,
                       const struct rte_eth_conf *eth_conf) {
+  castan_nb_rx_queues[port_id] = nb_rx_queue;
+  castan_nb_tx_queues[port_id] = nb_tx_queue;
   return 0;
 }
 
@@ -163,60 +439,294 @@ void __attribute__((weak)) rte_eth_promiscuous_enable(uint8_t portid) {
   return;
 }
 
-#define rte_eth_rx_burst castan_rte_eth_rx_burst
-uint16_t __attribute__((weak))
-castan_rte_eth_rx_burst(uint8_t port_id, uint16_t queue_id,
-                        struct rte_mbuf **rx_pkts, const uint16_t nb_pkts) {
-  if (port_id == 0) {
-    castan_loop();
+// Number of symbolic packets returned per rte_eth_rx_burst call, i.e. per
+// castan_loop iteration. Override with -DCASTAN_BURST_SIZE=<n>.
+#ifndef CASTAN_BURST_SIZE
+#define CASTAN_BURST_SIZE 1
+#endif
 
-    *rx_pkts = (struct rte_mbuf *)calloc(sizeof(struct rte_mbuf), 1);
-
-    (*rx_pkts)->buf_addr = malloc(sizeof(struct packet));
-    klee_make_symbolic((*rx_pkts)->buf_addr, sizeof(struct packet),
-                       "castan_packet");
-
-    (*rx_pkts)->buf_len = sizeof(struct packet);
-    (*rx_pkts)->nb_segs = 1;
-    (*rx_pkts)->port = 0;
-    (*rx_pkts)->packet_type = RTE_PTYPE_L2_ETHER;
-    (*rx_pkts)->pkt_len = sizeof(struct packet);
-    (*rx_pkts)->data_len = sizeof(struct packet);
-
-    klee_assume(((struct packet *)(*rx_pkts)->buf_addr)->ether.ether_type ==
-                htons(ETHER_TYPE_IPv4));
-    klee_assume(((struct packet *)(*rx_pkts)->buf_addr)->ipv4.version_ihl ==
-                (4 << 4 | 5));
-    klee_assume(((struct packet *)(*rx_pkts)->buf_addr)->ipv4.total_length ==
-                htons(sizeof(struct ipv4_hdr) + sizeof(struct udp_hdr)));
-    klee_assume(((struct packet *)(*rx_pkts)->buf_addr)->ipv4.next_proto_id ==
-                IPPROTO_UDP);
-    klee_assume(((struct packet *)(*rx_pkts)->buf_addr)->udp.dgram_len ==
-                htons(8));
-
-    if (ntohs(((struct packet *)(*rx_pkts)->buf_addr)->ether.ether_type) ==
-        ETHER_TYPE_IPv4) {
-      (*rx_pkts)->packet_type |= RTE_PTYPE_L3_IPV4;
+void __attribute__((weak))
+castan_init_packet(struct rte_mbuf *mbuf, uint8_t port_id) {
+  const struct castan_packet_template *t = castan_active_packet_template;
+  assert(t->min_size <= t->max_size && t->protocols &&
+         "Invalid packet template.");
+
+  mbuf->buf_addr = malloc(t->max_size);
+  klee_make_symbolic(mbuf->buf_addr, t->max_size, "castan_packet");
+
+  mbuf->buf_len = t->max_size;
+  mbuf->nb_segs = 1;
+  mbuf->port = port_id;
+  mbuf->packet_type = RTE_PTYPE_L2_ETHER;
+
+  uint8_t *data = (uint8_t *)mbuf->buf_addr;
+
+  // L2.
+  struct ether_hdr *ether = (struct ether_hdr *)data;
+  uint16_t l3_offset = sizeof(struct ether_hdr);
+  if (t->vlan) {
+    klee_assume((ether->ether_type == htons(ETHER_TYPE_IPv4)) |
+                (ether->ether_type == htons(ETHER_TYPE_VLAN)));
+  } else {
+    klee_assume(ether->ether_type == htons(ETHER_TYPE_IPv4));
+  }
+  if (ether->ether_type == htons(ETHER_TYPE_VLAN)) {
+    struct vlan_hdr *vlan = (struct vlan_hdr *)(data + l3_offset);
+    klee_assume(vlan->eth_proto == htons(ETHER_TYPE_IPv4));
+    l3_offset += sizeof(struct vlan_hdr);
+#ifdef RTE_PTYPE_L2_ETHER_VLAN
+    mbuf->packet_type = RTE_PTYPE_L2_ETHER_VLAN;
+#endif
+  }
+  mbuf->l2_len = l3_offset;
+  mbuf->packet_type |= RTE_PTYPE_L3_IPV4;
+
+  // L3.
+  struct ipv4_hdr *ipv4 = (struct ipv4_hdr *)(data + l3_offset);
+  klee_assume((ipv4->version_ihl >> 4) == 4);
+  klee_assume((ipv4->version_ihl & 0x0F) >= 5);
+  klee_assume((ipv4->version_ihl & 0x0F) <= 5 + t->max_ip_options);
+  // Resolve the header length concretely to keep the L4 offset concrete.
+  uint16_t l4_offset = l3_offset;
+  for (uint8_t ihl = 5; ihl <= 5 + t->max_ip_options; ihl++) {
+    if ((ipv4->version_ihl & 0x0F) == ihl) {
+      l4_offset += ihl * 4;
+      break;
     }
-    switch (((struct packet *)(*rx_pkts)->buf_addr)->ipv4.next_proto_id) {
-    case IPPROTO_UDP:
-      (*rx_pkts)->packet_type |= RTE_PTYPE_L4_UDP;
+  }
+  mbuf->l3_len = l4_offset - l3_offset;
+  if (mbuf->l3_len > sizeof(struct ipv4_hdr)) {
+    mbuf->packet_type =
+        (mbuf->packet_type & ~RTE_PTYPE_L3_MASK) | RTE_PTYPE_L3_IPV4_EXT;
+  }
+
+  uint8_t protocols = t->protocols;
+  if (t->max_size < l4_offset + sizeof(struct tcp_hdr)) {
+    protocols &= ~CASTAN_PROTO_TCP;
+  }
+  if (t->max_size < l4_offset + sizeof(struct udp_hdr)) {
+    protocols &= ~CASTAN_PROTO_UDP;
+  }
+  assert(protocols && "Packet template leaves no room for L4 headers.");
+  klee_assume(((protocols & CASTAN_PROTO_UDP) &&
+               ipv4->next_proto_id == IPPROTO_UDP) |
+              ((protocols & CASTAN_PROTO_TCP) &&
+               ipv4->next_proto_id == IPPROTO_TCP));
+
+  // Frame size range, as seen through the IPv4 total length.
+  uint16_t total_length = ntohs(ipv4->total_length);
+  klee_assume(l3_offset + total_length >= t->min_size);
+  klee_assume(l3_offset + total_length <= t->max_size);
+
+  // L4.
+  if (ipv4->next_proto_id == IPPROTO_UDP) {
+    struct udp_hdr *udp = (struct udp_hdr *)(data + l4_offset);
+    klee_assume(total_length >= mbuf->l3_len + sizeof(struct udp_hdr));
+    klee_assume(ntohs(udp->dgram_len) == total_length - mbuf->l3_len);
+    mbuf->l4_len = sizeof(struct udp_hdr);
+    mbuf->packet_type |= RTE_PTYPE_L4_UDP;
+  } else {
+    struct tcp_hdr *tcp = (struct tcp_hdr *)(data + l4_offset);
+    klee_assume(total_length >= mbuf->l3_len + sizeof(struct tcp_hdr));
+    klee_assume((tcp->data_off >> 4) == sizeof(struct tcp_hdr) / 4);
+    mbuf->l4_len = sizeof(struct tcp_hdr);
+    mbuf->packet_type |= RTE_PTYPE_L4_TCP;
+  }
+
+  // Fixed fields.
+  for (unsigned i = 0; i < t->num_fixed_fields; i++) {
+    const struct castan_packet_field *f = &t->fixed_fields[i];
+    uint16_t offset = f->offset;
+    switch (f->layer) {
+    case CASTAN_LAYER_L2:
       break;
-    case IPPROTO_TCP:
-      (*rx_pkts)->packet_type |= RTE_PTYPE_L4_TCP;
+    case CASTAN_LAYER_L3:
+      offset += l3_offset;
       break;
+    case CASTAN_LAYER_L4:
+      offset += l4_offset;
+      break;
+    }
+    assert(f->size <= sizeof(f->value) && offset + f->size <= t->max_size &&
+           "Fixed field out of bounds.");
+    for (uint8_t b = 0; b < f->size; b++) {
+      klee_assume(data[offset + b] == f->value[b]);
     }
+  }
 
-    return 1;
-  } else {
+  mbuf->pkt_len = l3_offset + total_length;
+  mbuf->data_len = mbuf->pkt_len;
+}
+
+// Port and queue that receive the current burst, or -1 if not chosen yet.
+int __attribute__((weak)) castan_rx_port = -1;
+int __attribute__((weak)) castan_rx_queue = -1;
+
+// The poll that chose the current port and queue. Seeing it again means the
+// NF went through a full round of polls without polling the chosen queue.
+int __attribute__((weak)) castan_rx_round_port = -1;
+int __attribute__((weak)) castan_rx_round_queue = -1;
+
+// Queues the NF has polled on each port, as a bit mask of the first 64.
+uint64_t __attribute__((weak)) castan_rx_polled[RTE_MAX_ETHPORTS];
+
+static inline int castan_rx_queue_polled(int port, int queue) {
+  return queue < 64 && ((castan_rx_polled[port] >> queue) & 1);
+}
+
+// Picks the port and queue that receive the next burst, among the configured
+// queues, or only among those that were polled if polled_only is set. The
+// choice is symbolic and recorded in the test case as castan_port /
+// castan_queue objects so that ktest2pcap can attribute packets to ports.
+// Without any configured port, port 0 queue 0 receives all traffic.
+void __attribute__((weak)) castan_choose_rx_queue(int polled_only) {
+  int port, queue;
+  klee_make_symbolic(&port, sizeof(port), "castan_port");
+  klee_make_symbolic(&queue, sizeof(queue), "castan_queue");
+
+  int configured = 0, valid = 0;
+  for (int p = 0; p < CASTAN_NUM_PORTS && p < RTE_MAX_ETHPORTS; p++) {
+    if (castan_nb_rx_queues[p]) {
+      configured = 1;
+      if (!polled_only) {
+        valid |=
+            (port == p) & (queue >= 0) & (queue < castan_nb_rx_queues[p]);
+        continue;
+      }
+      for (int q = 0; q < castan_nb_rx_queues[p]; q++) {
+        if (castan_rx_queue_polled(p, q)) {
+          valid |= (port == p) & (queue == q);
+        }
+      }
+    }
+  }
+  if (!configured) {
+    valid = (port == 0) & (queue == 0);
+    if (polled_only) {
+      valid = 0;
+      for (int p = 0; p < CASTAN_NUM_PORTS && p < RTE_MAX_ETHPORTS; p++) {
+        for (int q = 0; q < 64; q++) {
+          if (castan_rx_queue_polled(p, q)) {
+            valid |= (port == p) & (queue == q);
+          }
+        }
+      }
+    }
+  }
+  klee_assume(valid);
+
+  // Resolve the choice concretely, forking once per port and queue.
+  for (int p = 0; p < CASTAN_NUM_PORTS && p < RTE_MAX_ETHPORTS; p++) {
+    if (port == p) {
+      int nb_queues = castan_nb_rx_queues[p] ? castan_nb_rx_queues[p] : 64;
+      for (int q = 0; q < nb_queues; q++) {
+        if (queue == q) {
+          castan_rx_port = p;
+          castan_rx_queue = q;
+          return;
+        }
+      }
+    }
+  }
+}
+
+#define rte_eth_rx_burst castan_rte_eth_rx_burst
+uint16_t __attribute__((weak))
+castan_rte_eth_rx_burst(uint8_t port_id, uint16_t queue_id,
+                        struct rte_mbuf **rx_pkts, const uint16_t nb_pkts) {
+  if (port_id < RTE_MAX_ETHPORTS && queue_id < 64) {
+    castan_rx_polled[port_id] |= 1ull << queue_id;
+  }
+
+  if (castan_rx_port < 0) {
+    castan_loop();
+    castan_choose_rx_queue(0);
+    castan_rx_round_port = port_id;
+    castan_rx_round_queue = queue_id;
+  } else if (port_id == castan_rx_round_port &&
+             queue_id == castan_rx_round_queue) {
+    // The chosen queue is configured but never polled: choose again among
+    // the queues this round polled, so that the loop goes on.
+    castan_choose_rx_queue(1);
+  }
+
+  if (port_id != castan_rx_port || queue_id != castan_rx_queue) {
     return 0;
   }
+  castan_rx_port = -1;
+  castan_rx_queue = -1;
+
+  uint16_t burst_size =
+      nb_pkts < CASTAN_BURST_SIZE ? nb_pkts : CASTAN_BURST_SIZE;
+
+  // Record the burst boundary in the test case so that ktest2pcap can map
+  // packets back to bursts.
+  uint16_t burst_marker;
+  klee_make_symbolic(&burst_marker, sizeof(burst_marker), "castan_burst");
+  klee_assume(burst_marker == burst_size);
+  castan_burst(burst_size);
+
+  for (uint16_t i = 0; i < burst_size; i++) {
+    castan_advance_time();
+    rx_pkts[i] = (struct rte_mbuf *)calloc(sizeof(struct rte_mbuf), 1);
+    castan_init_packet(rx_pkts[i], port_id);
+  }
+
+  return burst_size;
 }
 
+// Models the work done by the PMD on transmission: reading each mbuf and
+// writing a descriptor into the queue's TX ring. The ring lives in NF memory,
+// so these accesses go through the cache model like any other.
+struct castan_tx_desc {
+  uint64_t buf_addr;
+  uint32_t len;
+  uint64_t flags;
+};
+
+struct castan_tx_ring {
+  struct castan_tx_desc *descs;
+  uint16_t tail;
+};
+
+struct castan_tx_ring __attribute__((weak))
+    *castan_tx_rings[RTE_MAX_ETHPORTS];
+// Number of rings allocated for each port.
+uint16_t __attribute__((weak)) castan_nb_tx_rings[RTE_MAX_ETHPORTS];
+
 #define rte_eth_tx_burst castan_rte_eth_tx_burst
 uint16_t __attribute__((weak))
 castan_rte_eth_tx_burst(uint8_t port_id, uint16_t queue_id,
                         struct rte_mbuf **tx_pkts, uint16_t nb_pkts) {
+  if (port_id >= RTE_MAX_ETHPORTS) {
+    return 0;
+  }
+
+  if (!castan_tx_rings[port_id]) {
+    uint16_t nb_queues =
+        castan_nb_tx_queues[port_id] ? castan_nb_tx_queues[port_id] : 1;
+    castan_tx_rings[port_id] = (struct castan_tx_ring *)calloc(
+        sizeof(struct castan_tx_ring), nb_queues);
+    for (uint16_t q = 0; q < nb_queues; q++) {
+      castan_tx_rings[port_id][q].descs = (struct castan_tx_desc *)calloc(
+          sizeof(struct castan_tx_desc), CASTAN_TX_RING_SIZE);
+    }
+    castan_nb_tx_rings[port_id] = nb_queues;
+  }
+
+  if (queue_id >= castan_nb_tx_rings[port_id]) {
+    return 0;
+  }
+
+  struct castan_tx_ring *ring = &castan_tx_rings[port_id][queue_id];
+  for (uint16_t i = 0; i < nb_pkts; i++) {
+    struct castan_tx_desc *desc = &ring->descs[ring->tail];
+    desc->buf_addr = (uint64_t)tx_pkts[i]->buf_addr + tx_pkts[i]->data_off;
+    desc->len = tx_pkts[i]->data_len;
+    desc->flags = tx_pkts[i]->ol_flags;
+    ring->tail = (ring->tail + 1) % CASTAN_TX_RING_SIZE;
+  }
+
   return nb_pkts;
 }
 
@@ -0,0 +1,394 @@
+// Native stand-in for the DPDK shim in castan-dpdk.h, used to validate the
+// cache model against the NF running on the local machine. Packets come from
+// a pcap file instead of symbolic input, and each one is timed with rdtsc.
+// When the NF is built with
+//   -fsanitize-coverage=trace-loads,trace-stores
+// the address of every load and store made while processing a packet is
+// recorded as well. scripts/castan-validate.sh builds and runs the NF this
+// way and feeds the traces to castan-validate.
+//
+// The contention sets of the cache model are indexed by the offset of an
+// address within its 1 GB page, which is only the physical offset if memory
+// is backed by 1 GB hugepages, as DPDK's is. The memory DPDK would allocate
+// (rte_zmalloc*, mempools and mbufs) therefore comes from 1 GB hugepages
+// here too, and the shim fails if none are available. The NF's stack,
+// globals and plain malloc'ed memory stay on ordinary pages, so the cache
+// behaviour predicted for their accesses is only approximate; NFs that keep
+// their state in rte_zmalloc'ed memory are validated exactly.
+//
+// Environment:
+//   CASTAN_PCAP  - the packets to process (default: nf.pcap).
+//   CASTAN_TRACE - where to write the trace (default: nf.trace).
+//
+// Trace format, as native 64-bit words:
+//   CASTAN_TRACE_MAGIC, TSC ticks per ns (as a double),
+//   then for each packet:
+//     (address << 1 | is-write) for each access,
+//     CASTAN_TRACE_END_PACKET, TSC ticks, instructions retired (or 0).
+
+#ifndef CASTAN_NATIVE_H
+#define CASTAN_NATIVE_H
+
+#define CASTAN_NATIVE
+
+#include <linux/mman.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <castan/castan.h>
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CASTAN_TRACE_MAGIC 0x43415354414e5452ull
+#define CASTAN_TRACE_END_PACKET (~0ull)
+
+// Number of ports reported by rte_eth_dev_count.
+// Override with -DCASTAN_NUM_PORTS=<n>.
+#ifndef CASTAN_NUM_PORTS
+#define CASTAN_NUM_PORTS 2
+#endif
+
+// Packets returned per rte_eth_rx_burst call, as in castan-dpdk.h.
+#ifndef CASTAN_BURST_SIZE
+#define CASTAN_BURST_SIZE 1
+#endif
+
+// Mbufs are reused round-robin, as a PMD would reuse them from its pool.
+#ifndef CASTAN_NATIVE_MBUFS
+#define CASTAN_NATIVE_MBUFS 1024
+#endif
+#ifndef CASTAN_NATIVE_MBUF_SIZE
+#define CASTAN_NATIVE_MBUF_SIZE 2048
+#endif
+
+#define CASTAN_NO_TRACE __attribute__((no_sanitize("coverage"), weak))
+
+#define CASTAN_NATIVE_HUGEPAGE_SIZE (1ull << 30)
+
+// Trace buffer, flushed when full.
+uint64_t __attribute__((weak)) castan_trace_buffer[4096];
+unsigned __attribute__((weak)) castan_trace_used = 0;
+FILE __attribute__((weak)) *castan_trace_file = NULL;
+// Whether a packet is being processed.
+int __attribute__((weak)) castan_trace_recording = 0;
+uint64_t __attribute__((weak)) castan_trace_start_tsc = 0;
+uint64_t __attribute__((weak)) castan_trace_start_instructions = 0;
+int __attribute__((weak)) castan_trace_perf_fd = -1;
+FILE __attribute__((weak)) *castan_pcap_file = NULL;
+int __attribute__((weak)) castan_pcap_swapped = 0;
+
+void CASTAN_NO_TRACE castan_native_fail(const char *message) {
+  fprintf(stderr, "castan-native: %s\n", message);
+  exit(1);
+}
+
+// Hugepage currently being allocated from, and the bytes of it in use.
+char __attribute__((weak)) *castan_hugepage = NULL;
+uint64_t __attribute__((weak)) castan_hugepage_used = 0;
+
+// Allocates zeroed memory from 1 GB hugepages. Nothing is ever freed, which
+// suits the set-up time allocations of an NF.
+void CASTAN_NO_TRACE *castan_native_hugepage_alloc(size_t size,
+                                                   unsigned align) {
+  if (size > CASTAN_NATIVE_HUGEPAGE_SIZE) {
+    castan_native_fail("allocation larger than a hugepage.");
+  }
+  if (align < sizeof(void *)) {
+    align = sizeof(void *);
+  }
+  uint64_t offset = (castan_hugepage_used + align - 1) & ~(uint64_t)(align - 1);
+  if (!castan_hugepage || offset + size > CASTAN_NATIVE_HUGEPAGE_SIZE) {
+    void *page = mmap(NULL, CASTAN_NATIVE_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB,
+                      -1, 0);
+    if (page == MAP_FAILED) {
+      castan_native_fail("unable to map a 1 GB hugepage (are any reserved?).");
+    }
+    castan_hugepage = (char *)page;
+    offset = 0;
+  }
+  castan_hugepage_used = offset + size;
+  // Fresh anonymous mappings are already zeroed.
+  return castan_hugepage + offset;
+}
+
+static inline uint64_t castan_native_rdtsc(void) {
+  uint32_t lo, hi;
+  __asm__ volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+void CASTAN_NO_TRACE castan_trace_word(uint64_t word) {
+  castan_trace_buffer[castan_trace_used++] = word;
+  if (castan_trace_used == sizeof(castan_trace_buffer) /
+                              sizeof(castan_trace_buffer[0])) {
+    fwrite(castan_trace_buffer, sizeof(uint64_t), castan_trace_used,
+           castan_trace_file);
+    castan_trace_used = 0;
+  }
+}
+
+void CASTAN_NO_TRACE castan_trace_flush(void) {
+  fwrite(castan_trace_buffer, sizeof(uint64_t), castan_trace_used,
+         castan_trace_file);
+  castan_trace_used = 0;
+  fflush(castan_trace_file);
+}
+
+#define CASTAN_TRACE_CALLBACK(name, type, is_write)                            \
+  void CASTAN_NO_TRACE name(type *addr) {                                      \
+    if (castan_trace_recording) {                                              \
+      castan_trace_word(((uint64_t)addr << 1) | is_write);                     \
+    }                                                                          \
+  }
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_load1, uint8_t, 0)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_load2, uint16_t, 0)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_load4, uint32_t, 0)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_load8, uint64_t, 0)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_load16, __int128, 0)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_store1, uint8_t, 1)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_store2, uint16_t, 1)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_store4, uint32_t, 1)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_store8, uint64_t, 1)
+CASTAN_TRACE_CALLBACK(__sanitizer_cov_store16, __int128, 1)
+
+uint64_t CASTAN_NO_TRACE castan_native_instructions(void) {
+  uint64_t count = 0;
+  if (castan_trace_perf_fd >= 0 &&
+      read(castan_trace_perf_fd, &count, sizeof(count)) != sizeof(count)) {
+    count = 0;
+  }
+  return count;
+}
+
+void CASTAN_NO_TRACE castan_native_init(void) {
+  const char *trace = getenv("CASTAN_TRACE");
+  castan_trace_file = fopen(trace ? trace : "nf.trace", "wb");
+  if (!castan_trace_file) {
+    castan_native_fail("unable to open trace file.");
+  }
+
+  const char *pcap = getenv("CASTAN_PCAP");
+  castan_pcap_file = fopen(pcap ? pcap : "nf.pcap", "rb");
+  if (!castan_pcap_file) {
+    castan_native_fail("unable to open pcap file.");
+  }
+  uint32_t header[6];
+  if (fread(header, sizeof(header), 1, castan_pcap_file) != 1) {
+    castan_native_fail("truncated pcap file.");
+  }
+  if (header[0] == 0xd4c3b2a1 || header[0] == 0x4d3cb2a1) {
+    castan_pcap_swapped = 1;
+  } else if (header[0] != 0xa1b2c3d4 && header[0] != 0xa1b23c4d) {
+    castan_native_fail("not a pcap file (pcapng is not supported).");
+  }
+
+  // User-space instructions retired, if the kernel lets us count them.
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  castan_trace_perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+  // TSC frequency, so that cycles can be compared to ns.
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t tsc = castan_native_rdtsc();
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000000ll + now.tv_nsec -
+               start.tv_nsec <
+           200000000ll);
+  double tsc_per_ns = (castan_native_rdtsc() - tsc) /
+                      (double)((now.tv_sec - start.tv_sec) * 1000000000ll +
+                               now.tv_nsec - start.tv_nsec);
+
+  uint64_t tsc_word;
+  memcpy(&tsc_word, &tsc_per_ns, sizeof(tsc_word));
+  castan_trace_word(CASTAN_TRACE_MAGIC);
+  castan_trace_word(tsc_word);
+}
+
+void CASTAN_NO_TRACE castan_native_end_packet(void) {
+  uint64_t tsc = castan_native_rdtsc();
+  uint64_t instructions = castan_native_instructions();
+  castan_trace_recording = 0;
+
+  castan_trace_word(CASTAN_TRACE_END_PACKET);
+  castan_trace_word(tsc - castan_trace_start_tsc);
+  castan_trace_word(instructions - castan_trace_start_instructions);
+}
+
+static inline uint32_t castan_pcap_word(uint32_t word) {
+  return castan_pcap_swapped ? __builtin_bswap32(word) : word;
+}
+
+// Reads the next packet into mbuf, returning 0 at the end of the file.
+int CASTAN_NO_TRACE castan_native_read_packet(struct rte_mbuf *mbuf,
+                                              uint8_t port_id) {
+  uint32_t header[4];
+  if (fread(header, sizeof(header), 1, castan_pcap_file) != 1) {
+    return 0;
+  }
+  uint32_t length = castan_pcap_word(header[2]);
+  if (length > CASTAN_NATIVE_MBUF_SIZE) {
+    castan_native_fail("packet larger than CASTAN_NATIVE_MBUF_SIZE.");
+  }
+  if (fread(mbuf->buf_addr, 1, length, castan_pcap_file) != length) {
+    return 0;
+  }
+
+  mbuf->data_off = 0;
+  mbuf->nb_segs = 1;
+  mbuf->port = port_id;
+  mbuf->packet_type = RTE_PTYPE_L2_ETHER;
+  mbuf->pkt_len = length;
+  mbuf->data_len = length;
+  return 1;
+}
+
+// Queues configured by the NF on each port.
+uint16_t __attribute__((weak)) castan_nb_rx_queues[RTE_MAX_ETHPORTS];
+uint16_t __attribute__((weak)) castan_nb_tx_queues[RTE_MAX_ETHPORTS];
+
+#define rte_eth_rx_burst castan_rte_eth_rx_burst
+uint16_t CASTAN_NO_TRACE castan_rte_eth_rx_burst(uint8_t port_id,
+                                                 uint16_t queue_id,
+                                                 struct rte_mbuf **rx_pkts,
+                                                 const uint16_t nb_pkts) {
+  static struct rte_mbuf *mbufs[CASTAN_NATIVE_MBUFS];
+  static unsigned next_mbuf = 0;
+
+  // All packets arrive on port 0, queue 0.
+  if (port_id != 0 || queue_id != 0) {
+    return 0;
+  }
+
+  if (!castan_trace_file) {
+    castan_native_init();
+  }
+  if (castan_trace_recording) {
+    castan_native_end_packet();
+  }
+
+  uint16_t burst_size =
+      nb_pkts < CASTAN_BURST_SIZE ? nb_pkts : CASTAN_BURST_SIZE;
+  for (uint16_t i = 0; i < burst_size; i++) {
+    struct rte_mbuf **mbuf = &mbufs[next_mbuf];
+    next_mbuf = (next_mbuf + 1) % CASTAN_NATIVE_MBUFS;
+    if (!*mbuf) {
+      *mbuf = (struct rte_mbuf *)castan_native_hugepage_alloc(
+          sizeof(struct rte_mbuf), RTE_CACHE_LINE_SIZE);
+      (*mbuf)->buf_addr = castan_native_hugepage_alloc(CASTAN_NATIVE_MBUF_SIZE,
+                                                       RTE_CACHE_LINE_SIZE);
+      (*mbuf)->buf_len = CASTAN_NATIVE_MBUF_SIZE;
+    }
+    if (!castan_native_read_packet(*mbuf, port_id)) {
+      if (i == 0) {
+        castan_trace_flush();
+        exit(0);
+      }
+      burst_size = i;
+      break;
+    }
+    rx_pkts[i] = *mbuf;
+  }
+
+  castan_trace_recording = 1;
+  castan_trace_start_instructions = castan_native_instructions();
+  castan_trace_start_tsc = castan_native_rdtsc();
+  return burst_size;
+}
+
+#define rte_eth_tx_burst castan_rte_eth_tx_burst
+uint16_t CASTAN_NO_TRACE castan_rte_eth_tx_burst(uint8_t port_id,
+                                                 uint16_t queue_id,
+                                                 struct rte_mbuf **tx_pkts,
+                                                 uint16_t nb_pkts) {
+  return nb_pkts;
+}
+
+// EAL and device set-up, which has nothing to do natively.
+int __attribute__((weak)) rte_eal_init(int argc, char **argv) { return 0; }
+
+void __attribute__((weak)) rte_exit(int exit_code, const char *format, ...) {
+  exit(exit_code);
+}
+
+void __attribute__((weak)) *
+    rte_zmalloc(const char *type, size_t size, unsigned align) {
+  return castan_native_hugepage_alloc(size, align);
+}
+
+void __attribute__((weak)) * rte_zmalloc_socket(const char *type, size_t size,
+                                                unsigned align, int socket) {
+  return rte_zmalloc(type, size, align);
+}
+
+unsigned __attribute__((weak)) rte_socket_id() { return 0; }
+
+uint8_t __attribute__((weak)) rte_eth_dev_count() { return CASTAN_NUM_PORTS; }
+
+void __attribute__((weak))
+rte_eth_macaddr_get(uint8_t port_id, struct ether_addr *mac_addr) {
+  memset(mac_addr, 0, sizeof(*mac_addr));
+  mac_addr->addr_bytes[5] = port_id;
+}
+
+struct rte_mempool __attribute__((weak)) *
+    rte_pktmbuf_pool_create(const char *name, unsigned n, unsigned cache_size,
+                            uint16_t priv_size, uint16_t data_room_size,
+                            int socket_id) {
+  return (struct rte_mempool *)castan_native_hugepage_alloc(
+      sizeof(struct rte_mempool), RTE_CACHE_LINE_SIZE);
+}
+
+int __attribute__((weak))
+rte_eth_dev_configure(uint8_t port_id, uint16_t nb_rx_queue,
+                      uint16_t nb_tx_queue,
+                      const struct rte_eth_conf *eth_conf) {
+  castan_nb_rx_queues[port_id] = nb_rx_queue;
+  castan_nb_tx_queues[port_id] = nb_tx_queue;
+  return 0;
+}
+
+int __attribute__((weak)) rte_eth_dev_socket_id(uint8_t device) { return 0; }
+
+int __attribute__((weak))
+rte_eth_tx_queue_setup(uint8_t port_id, uint16_t tx_queue_id,
+                       uint16_t nb_tx_desc, unsigned int socket_id,
+                       const struct rte_eth_txconf *tx_conf) {
+  return 0;
+}
+
+int __attribute__((weak))
+rte_eth_rx_queue_setup(uint8_t port_id, uint16_t rx_queue_id,
+                       uint16_t nb_rx_desc, unsigned int socket_id,
+                       const struct rte_eth_rxconf *rx_conf,
+                       struct rte_mempool *mb_pool) {
+  return 0;
+}
+
+int __attribute__((weak)) rte_eth_dev_start(uint8_t portid) { return 0; }
+
+void __attribute__((weak)) rte_eth_promiscuous_enable(uint8_t portid) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
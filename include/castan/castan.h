@@ -1,13 +1,16 @@
 #include <klee/klee.h>
 #include <string.h>
 
-#ifdef __clang__
+// Native builds (see castan-native.h) run the NF concretely, as other
+// compilers do.
+#if defined(__clang__) && !defined(CASTAN_NATIVE)
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void castan_loop();
+void castan_burst(unsigned packets);
 
 #ifdef __cplusplus
 }
@@ -27,6 +30,7 @@ void castan_loop();
 #else
 
 void castan_loop() {}
+void castan_burst(unsigned packets) {}
 
 #define castan_havoc(input, output, expr)                                      \
   do {                                                                         \
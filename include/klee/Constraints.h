@@ -11,6 +11,9 @@
 #define KLEE_CONSTRAINTS_H
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+#include <map>
 
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
@@ -26,14 +29,30 @@ public:
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
-  ConstraintManager() {}
+  ConstraintManager() : lineage(nextStamp()), generation(lineage) {}
 
   // create from constraints with no optimization
   explicit
-  ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+  ConstraintManager(const std::vector< ref<Expr> > &_constraints)
+    : lineage(nextStamp()), generation(lineage) {
+    for (constraints_ty::const_iterator it = _constraints.begin(),
+           ie = _constraints.end(); it != ie; ++it)
+      pushConstraint(*it);
+  }
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const ConstraintManager &cs)
+    : constraints(cs.constraints), equalities(cs.equalities),
+      lineage(cs.lineage), generation(cs.generation) {}
+
+  // The assigned constraints need not imply the replaced ones, so this
+  // starts a new lineage.
+  ConstraintManager &operator=(const ConstraintManager &cs) {
+    constraints = cs.constraints;
+    equalities = cs.equalities;
+    simplified.clear();
+    lineage = generation = nextStamp();
+    return *this;
+  }
 
   typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
 
@@ -64,10 +83,37 @@ public:
   bool operator==(const ConstraintManager &other) const {
     return constraints == other.constraints;
   }
+
+  /// getLineage - Identifies a sequence of constraint sets, each implying
+  /// the previous ones. Copies share their original's lineage; a new set,
+  /// or one assigned over, starts a new one.
+  unsigned getLineage() const { return lineage; }
+
+  /// getGeneration - Changes whenever the constraints change, and is never
+  /// shared by two different sets of constraints.
+  unsigned getGeneration() const { return generation; }
   
 private:
+  typedef ImmutableMap< ref<Expr>, ref<Expr> > equalities_ty;
+
   std::vector< ref<Expr> > constraints;
 
+  // Substitutions implied by the constraints, used by simplifyExpr: the
+  // non-constant side of an equality with a constant maps to the constant,
+  // and any other constraint maps to true. Maintained as constraints are
+  // added, and shared between copies.
+  equalities_ty equalities;
+
+  // simplifyExpr results for the current constraints. Not copied.
+  mutable std::map< ref<Expr>, ref<Expr> > simplified;
+
+  unsigned lineage;
+  unsigned generation;
+
+  static unsigned nextStamp();
+
+  void pushConstraint(ref<Expr> e);
+
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
@@ -176,10 +176,21 @@ public:
 
 protected:  
   unsigned hashValue;
-  
+
+private:
+  /// Whether this node is the shared instance of its structure.
+  bool interned;
+
+  static Expr *internNode(Expr *e);
+
 public:
-  Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  Expr() : refCount(0), interned(false) { Expr::count++; }
+  virtual ~Expr();
+
+  /// Nodes come from size-class pools rather than malloc (see
+  /// lib/Expr/NodeAllocator.h).
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -198,6 +209,13 @@ public:
   /// (Re)computes the hash of the current expression.
   /// Returns the hash value. 
   virtual unsigned computeHash();
+
+  /// Returns the live node that is structurally equal to e, making e that
+  /// node if there is none, so that equal expressions share one object.
+  /// The hash of e must already be computed.
+  template <class T> static ref<T> intern(const ref<T> &e) {
+    return static_cast<T *>(internNode(e.get()));
+  }
   
   /// Returns 0 iff b is structuraly equivalent to *this
   typedef llvm::DenseSet<std::pair<const Expr *, const Expr *> > ExprEquivSet;
@@ -388,7 +406,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -433,6 +451,9 @@ public:
              const ref<Expr> &_index, 
              const ref<Expr> &_value);
 
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
   unsigned getSize() const { return size; }
 
   int compare(const UpdateNode &b) const;  
@@ -542,7 +563,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -587,7 +608,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -644,7 +665,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return intern(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -703,7 +724,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -754,7 +775,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -831,7 +852,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return intern(r);                                          \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -863,7 +884,7 @@ public:                                                              \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
-      return res;                                                    \
+      return intern(res);                                            \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
     Width getWidth() const { return left->getWidth(); }              \
@@ -907,7 +928,7 @@ public:                                                              \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
-      return res;                                                    \
+      return intern(res);                                            \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
     Kind getKind() const { return _class_kind; }                     \
@@ -1008,7 +1029,7 @@ public:
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return intern(r);
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
@@ -0,0 +1,228 @@
+//===-- PagedArray.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAGEDARRAY_H
+#define KLEE_PAGEDARRAY_H
+
+#include "klee/Internal/System/SpillArena.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace klee {
+
+  /// A fixed-size array with copy-on-write pages. Copies share the pages of
+  /// the original and a write only duplicates the page it touches, so
+  /// copying a large array that is then written in a few places costs about
+  /// one pointer per page. Pages that were never written are not allocated
+  /// at all, so a large array costs memory in proportion to what differs
+  /// from its initial value. Arrays that fit in a single page are stored
+  /// inline and copied eagerly, as that is cheaper than sharing them.
+  template <typename T, unsigned PageSize = 4096>
+  class PagedArray {
+    struct Page {
+      unsigned refCount;
+      T data[PageSize];
+
+      Page() : refCount(1) {}
+
+      // Pages are what makes up the bulk of large objects, so they are the
+      // part of a state that can be spilled to disk.
+      static void *operator new(size_t size) {
+        return util::AllocateSpillable(size);
+      }
+      static void operator delete(void *p, size_t size) {
+        util::FreeSpillable(p, size);
+      }
+    };
+
+    unsigned size;
+    /// Storage of arrays of at most one page.
+    T *data;
+    /// Pages of larger arrays, the last one partially used. Null pages hold
+    /// defaultValue throughout.
+    Page **pages;
+    T defaultValue;
+
+    unsigned getNumPages() const { return (size + PageSize - 1) / PageSize; }
+
+    /// Whether page index holds the elements starting at src.
+    bool pageEquals(unsigned index, const T *src) const {
+      unsigned n = std::min(PageSize, size - index * PageSize);
+      if (pages[index])
+        return std::equal(pages[index]->data, pages[index]->data + n, src);
+      for (unsigned i = 0; i < n; i++)
+        if (!(src[i] == defaultValue))
+          return false;
+      return true;
+    }
+
+    static void release(Page *page) {
+      if (page && --page->refCount == 0)
+        delete page;
+    }
+
+    Page *getWriteablePage(unsigned index) {
+      Page *&page = pages[index];
+      if (!page) {
+        page = new Page();
+        std::fill(page->data, page->data + PageSize, defaultValue);
+      } else if (page->refCount > 1) {
+        Page *copy = new Page();
+        std::copy(page->data, page->data + PageSize, copy->data);
+        release(page);
+        page = copy;
+      }
+      return page;
+    }
+
+    PagedArray &operator=(const PagedArray &);
+
+  public:
+    explicit PagedArray(unsigned _size, const T &value = T())
+      : size(_size), data(0), pages(0), defaultValue(value) {
+      if (size <= PageSize) {
+        data = new T[size];
+        std::fill(data, data + size, value);
+      } else {
+        pages = new Page*[getNumPages()];
+        std::fill(pages, pages + getNumPages(), (Page *) 0);
+      }
+    }
+
+    PagedArray(const PagedArray &b)
+      : size(b.size), data(0), pages(0), defaultValue(b.defaultValue) {
+      if (b.data) {
+        data = new T[size];
+        std::copy(b.data, b.data + size, data);
+      } else {
+        pages = new Page*[getNumPages()];
+        for (unsigned i = 0; i < getNumPages(); i++) {
+          pages[i] = b.pages[i];
+          if (pages[i])
+            pages[i]->refCount++;
+        }
+      }
+    }
+
+    ~PagedArray() {
+      if (data) {
+        delete[] data;
+      } else {
+        for (unsigned i = 0; i < getNumPages(); i++)
+          release(pages[i]);
+        delete[] pages;
+      }
+    }
+
+    unsigned getSize() const { return size; }
+
+    const T &operator[](unsigned index) const {
+      assert(index < size && "out of bounds array access");
+      if (data)
+        return data[index];
+      const Page *page = pages[index / PageSize];
+      return page ? page->data[index % PageSize] : defaultValue;
+    }
+
+    /// Returns a reference to an element, unsharing its page.
+    T &getWriteable(unsigned index) {
+      assert(index < size && "out of bounds array access");
+      if (data)
+        return data[index];
+      return getWriteablePage(index / PageSize)->data[index % PageSize];
+    }
+
+    void set(unsigned index, const T &value) { getWriteable(index) = value; }
+
+    /// Restores the initial value of an element. A page that was never
+    /// written already holds it and stays unallocated.
+    void reset(unsigned index) {
+      assert(index < size && "out of bounds array access");
+      if (data)
+        data[index] = defaultValue;
+      else if (pages[index / PageSize])
+        getWriteable(index) = defaultValue;
+    }
+
+    /// Number of pages allocated for this array, 0 if it is stored inline.
+    unsigned getNumAllocatedPages() const {
+      unsigned count = 0;
+      if (pages)
+        for (unsigned i = 0; i < getNumPages(); i++)
+          if (pages[i])
+            count++;
+      return count;
+    }
+
+    /// Number of bytes a copy of this array duplicates: the elements of an
+    /// inline array, or only the page table of a paged one.
+    size_t getCopySize() const {
+      return data ? size * sizeof(T) : getNumPages() * sizeof(Page *);
+    }
+
+    /// Whether this array and b share the page holding element index.
+    bool sharesPage(const PagedArray &b, unsigned index) const {
+      return pages && b.pages && pages[index / PageSize] &&
+             pages[index / PageSize] == b.pages[index / PageSize];
+    }
+
+    void fill(const T &value) {
+      if (data) {
+        std::fill(data, data + size, value);
+        return;
+      }
+      for (unsigned i = 0; i < getNumPages(); i++) {
+        release(pages[i]);
+        pages[i] = 0;
+      }
+      defaultValue = value;
+    }
+
+    void copyOut(T *dst) const {
+      if (data) {
+        std::copy(data, data + size, dst);
+        return;
+      }
+      for (unsigned i = 0; i < getNumPages(); i++) {
+        unsigned n = std::min(PageSize, size - i * PageSize);
+        if (pages[i])
+          std::copy(pages[i]->data, pages[i]->data + n, dst + i * PageSize);
+        else
+          std::fill(dst + i * PageSize, dst + i * PageSize + n, defaultValue);
+      }
+    }
+
+    bool equals(const T *src) const {
+      if (data)
+        return std::equal(data, data + size, src);
+      for (unsigned i = 0; i < getNumPages(); i++)
+        if (!pageEquals(i, src + i * PageSize))
+          return false;
+      return true;
+    }
+
+    /// Overwrite the contents with src, leaving pages that do not change
+    /// shared.
+    void copyIn(const T *src) {
+      if (data) {
+        std::copy(src, src + size, data);
+        return;
+      }
+      for (unsigned i = 0; i < getNumPages(); i++) {
+        unsigned n = std::min(PageSize, size - i * PageSize);
+        const T *begin = src + i * PageSize;
+        if (!pageEquals(i, begin))
+          std::copy(begin, begin + n, getWriteablePage(i)->data);
+      }
+    }
+  };
+}
+
+#endif
@@ -15,8 +15,58 @@
 namespace klee {
   class MemoryObject;
 
+  /// A register or constant table entry. Concrete values of up to 64 bits
+  /// are kept inline so that the interpreter can operate on them without
+  /// allocating ConstantExprs; the expression is only built when a client
+  /// asks for it.
   struct Cell {
-    ref<Expr> value;
+  private:
+    mutable ref<Expr> value;
+    uint64_t immediate;
+    /// Width of the inline value, or InvalidWidth if the cell holds an
+    /// expression (or nothing).
+    Expr::Width immediateWidth;
+
+  public:
+    Cell() : immediate(0), immediateWidth(Expr::InvalidWidth) {}
+
+    bool isImmediate() const {
+      return immediateWidth != Expr::InvalidWidth;
+    }
+
+    uint64_t getImmediate() const {
+      assert(isImmediate() && "cell does not hold an immediate");
+      return immediate;
+    }
+
+    Expr::Width getWidth() const {
+      return isImmediate() ? immediateWidth : value->getWidth();
+    }
+
+    /// Returns the value as an expression, or null if the cell is unset.
+    const ref<Expr> &getValue() const {
+      if (value.isNull() && isImmediate())
+        value = ConstantExpr::alloc(immediate, immediateWidth);
+      return value;
+    }
+
+    void setValue(const ref<Expr> &e) {
+      value = e;
+      immediateWidth = Expr::InvalidWidth;
+      if (ConstantExpr *ce = dyn_cast_or_null<ConstantExpr>(e.get())) {
+        if (ce->getWidth() <= 64) {
+          immediate = ce->getZExtValue();
+          immediateWidth = ce->getWidth();
+        }
+      }
+    }
+
+    void setImmediate(uint64_t v, Expr::Width w) {
+      assert(w != Expr::InvalidWidth && w <= 64 && "invalid immediate width");
+      value = ref<Expr>();
+      immediate = v;
+      immediateWidth = w;
+    }
   };
 }
 
@@ -0,0 +1,40 @@
+//===-- SpillArena.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_SPILLARENA_H
+#define KLEE_UTIL_SPILLARENA_H
+
+#include <cstddef>
+#include <string>
+
+namespace klee {
+  namespace util {
+    /// Allocate later spillable pages from a shared mapping of an unlinked
+    /// file in dir. Under memory pressure the kernel then writes the least
+    /// recently used of them, which are mostly those of states that are not
+    /// running, back to that file and reads them in again when they are
+    /// touched, instead of the process running out of memory. Without it
+    /// spillable pages come from the heap.
+    bool EnableSpillArena(const std::string &dir, std::string &error);
+
+    /// Allocate a block that may be spilled. Only blocks of at least a page,
+    /// the pages of large objects, come from the spill file; smaller ones
+    /// and any the file cannot hold come from the heap.
+    void *AllocateSpillable(size_t size);
+    void FreeSpillable(void *p, size_t size);
+
+    /// Bytes currently allocated from the spill file.
+    size_t GetSpillArenaUsage();
+
+    /// Bytes of the spill file currently held in memory.
+    size_t GetSpillArenaResidentUsage();
+  }
+}
+
+#endif
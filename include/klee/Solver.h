@@ -282,6 +282,14 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCexCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which caches query
+  /// results in a file shared across runs. Queries are matched up to the
+  /// naming of their arrays.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The cache file, created if it does not exist.
+  Solver *createPersistentCachingSolver(Solver *s, std::string path);
+
   /// createFastCexSolver - Create a "fast counterexample solver", which tries
   /// to quickly compute a satisfying assignment for a constraint set using
   /// value propogation and range analysis.
@@ -307,6 +315,15 @@ namespace klee {
                                     int minQueryTimeToLog);
 
 
+  /// createPortfolioSolver - Create a solver which races several core
+  /// solvers on each query and returns the first answer, learning which one
+  /// to use for each kind of query as it goes.
+  ///
+  /// \param solvers - The core solvers to race, owned by the new solver.
+  /// \param names - The name of each solver, for reporting.
+  Solver *createPortfolioSolver(const std::vector<Solver *> &solvers,
+                                const std::vector<std::string> &names);
+
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
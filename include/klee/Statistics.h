@@ -45,6 +45,9 @@ namespace klee {
     uint64_t *indexedStats;
     StatisticRecord *contextStats;
     unsigned index;
+    /// Factor applied to indexed and context increments, so that a sampled
+    /// index can stand in for the ones that were not sampled.
+    uint64_t indexedScale;
 
   public:
     StatisticManager();
@@ -57,6 +60,8 @@ namespace klee {
 
     void setIndex(unsigned i) { index = i; }
     unsigned getIndex() { return index; }
+    void setIndexedScale(uint64_t scale) { indexedScale = scale; }
+    uint64_t getIndexedScale() { return indexedScale; }
     unsigned getNumStatistics() { return stats.size(); }
     Statistic &getStatistic(unsigned i) { return *stats[i]; }
     
@@ -78,9 +83,9 @@ namespace klee {
     if (enabled) {
       globalStats[s.id] += addend;
       if (indexedStats) {
-        indexedStats[index*stats.size() + s.id] += addend;
+        indexedStats[index*stats.size() + s.id] += addend * indexedScale;
         if (contextStats)
-          contextStats->data[s.id] += addend;
+          contextStats->data[s.id] += addend * indexedScale;
       }
     }
   }
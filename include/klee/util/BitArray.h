@@ -10,31 +10,41 @@
 #ifndef KLEE_UTIL_BITARRAY_H
 #define KLEE_UTIL_BITARRAY_H
 
+#include "klee/Internal/ADT/PagedArray.h"
+
+#include <stdint.h>
+
 namespace klee {
 
-  // XXX would be nice not to have
-  // two allocations here for allocated
-  // BitArrays
+  // Bits are kept in copy-on-write pages of 4096 bits, so that copies of
+  // the masks of large objects share everything but the pages written, and
+  // pages that still hold the initial value are never allocated.
 class BitArray {
 private:
-  uint32_t *bits;
+  PagedArray<uint32_t, 128> bits;
   
 protected:
   static uint32_t length(unsigned size) { return (size+31)/32; }
 
 public:
-  BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]) {
-    memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
-  }
-  BitArray(const BitArray &b, unsigned size) : bits(new uint32_t[length(size)]) {
-    memcpy(bits, b.bits, sizeof(*bits)*length(size));
+  BitArray(unsigned size, bool value = false)
+    : bits(length(size), value ? 0xFFFFFFFF : 0) {}
+  BitArray(const BitArray &b, unsigned size) : bits(b.bits) {
+    assert(bits.getSize() == length(size) && "size mismatch");
   }
-  ~BitArray() { delete[] bits; }
 
-  bool get(unsigned idx) { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
-  void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
-  void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
+  bool get(unsigned idx) const { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
+  // Writes that change nothing leave shared and unallocated pages alone.
+  void set(unsigned idx) {
+    if (!get(idx)) bits.getWriteable(idx/32) |= 1<<(idx&0x1F);
+  }
+  void unset(unsigned idx) {
+    if (get(idx)) bits.getWriteable(idx/32) &= ~(1<<(idx&0x1F));
+  }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  unsigned getNumAllocatedPages() const { return bits.getNumAllocatedPages(); }
+  size_t getCopySize() const { return bits.getCopySize(); }
 };
 
 } // End klee namespace
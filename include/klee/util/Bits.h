@@ -97,6 +97,14 @@ namespace klee {
     inline uint64_t indexOfRightmostBit(uint64_t x) {
       return indexOfSingleBit(isolateRightmostBit(x));
     }
+
+    // Number of bits needed to represent x, 0 for 0.
+    inline unsigned numBits(uint64_t x) {
+      unsigned res = 0;
+      for (; x; x >>= 1)
+        res++;
+      return res;
+    }
   }
 } // End klee namespace
 
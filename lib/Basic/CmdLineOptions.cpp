@@ -64,6 +64,12 @@ CoreSolverOptimizeDivides("solver-optimize-divides",
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=off)"),
                  llvm::cl::init(false));
 
+llvm::cl::opt<std::string>
+QueryCacheFile("query-cache-file",
+               llvm::cl::desc("Cache solver results in the given file and "
+                              "reuse them across runs (default=off)"),
+               llvm::cl::init(""));
+
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness when it comes to checking
  * if an option is set. Unfortunately with gcc4.7 cl::bits<> is broken with LLVM2.9 and I doubt everyone
@@ -137,9 +143,20 @@ llvm::cl::opt<CoreSolverType> CoreSolverToUse(
                      clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT" METASMT_IS_DEFAULT_STR),
                      clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
                      clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+                     clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                                "Race the --portfolio-solver-backends"),
                      clEnumValEnd),
     llvm::cl::init(DEFAULT_CORE_SOLVER));
 
+llvm::cl::list<CoreSolverType> PortfolioSolverBackends(
+    "portfolio-solver-backends", llvm::cl::CommaSeparated,
+    llvm::cl::desc("Core solvers to race with --solver-backend=portfolio "
+                   "(default=all available)"),
+    llvm::cl::values(clEnumValN(STP_SOLVER, "stp", "stp"),
+                     clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+                     clEnumValN(Z3_SOLVER, "z3", "Z3"),
+                     clEnumValEnd));
+
 llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
     "debug-crosscheck-core-solver",
     llvm::cl::desc(
@@ -36,6 +36,11 @@ Solver *constructSolverChain(Solver *coreSolver, std::string querySMT2LogPath,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (!QueryCacheFile.empty()) {
+    solver = createPersistentCachingSolver(solver, QueryCacheFile);
+    klee_message("Caching solver results in %s\n", QueryCacheFile.c_str());
+  }
+
   if (UseFastCexSolver)
     solver = createFastCexSolver(solver);
 
@@ -18,7 +18,8 @@ StatisticManager::StatisticManager()
     globalStats(0),
     indexedStats(0),
     contextStats(0),
-    index(0) {
+    index(0),
+    indexedScale(1) {
 }
 
 StatisticManager::~StatisticManager() {
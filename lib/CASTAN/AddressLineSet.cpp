@@ -0,0 +1,185 @@
+#include <castan/Internal/AddressLineSet.h>
+
+#include "klee/util/Bits.h"
+
+// Most lines to enumerate before giving up on a precise set.
+#define MAX_ENUMERATED_LINES (1 << 16)
+
+namespace castan {
+AddressLineSet::AddressLineSet(const klee::ConstraintManager &constraints,
+                               klee::ref<klee::Expr> address,
+                               unsigned blockBits, unsigned pageBits)
+    : blockBits(blockBits), pageBits(pageBits) {
+  if (address->getWidth() > 64) {
+    return;
+  }
+
+  uint64_t base = 0, scale = 0;
+  klee::ref<klee::Expr> index;
+  if (!decompose(address, 1, base, scale, index)) {
+    return;
+  }
+
+  uint64_t lineMask = ((1ULL << pageBits) - 1) & ~((1ULL << blockBits) - 1);
+  if (index.isNull() || scale == 0) {
+    lines.insert(base & lineMask);
+    known = true;
+    return;
+  }
+
+  uint64_t min, max;
+  bound(constraints, index, min, max);
+  if (min > max) {
+    // The constraints look infeasible: let the solver decide.
+    return;
+  }
+
+  // The line only depends on the low pageBits of scale * index, which repeat
+  // with this period in index.
+  unsigned trailingZeros = 0;
+  while (!(scale & (1ULL << trailingZeros))) {
+    trailingZeros++;
+  }
+  uint64_t period = trailingZeros >= pageBits
+                        ? 1
+                        : 1ULL << (pageBits - trailingZeros);
+  uint64_t count = (max - min >= period - 1) ? period : max - min + 1;
+  if (count > MAX_ENUMERATED_LINES) {
+    return;
+  }
+
+  for (uint64_t i = 0; i < count; i++) {
+    lines.insert((base + scale * (min + i)) & lineMask);
+  }
+  known = true;
+}
+
+bool AddressLineSet::decompose(klee::ref<klee::Expr> e, uint64_t multiplier,
+                               uint64_t &base, uint64_t &scale,
+                               klee::ref<klee::Expr> &index) {
+  if (klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(e)) {
+    base += multiplier * ce->getZExtValue();
+    return true;
+  }
+
+  switch (e->getKind()) {
+  case klee::Expr::Add:
+    return decompose(e->getKid(0), multiplier, base, scale, index) &&
+           decompose(e->getKid(1), multiplier, base, scale, index);
+  case klee::Expr::Sub:
+    return decompose(e->getKid(0), multiplier, base, scale, index) &&
+           decompose(e->getKid(1), -multiplier, base, scale, index);
+  case klee::Expr::Mul:
+    // Constants are canonically on the left.
+    if (klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(e->getKid(0))) {
+      return decompose(e->getKid(1), multiplier * ce->getZExtValue(), base,
+                       scale, index);
+    }
+    break;
+  case klee::Expr::Shl:
+    if (klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(e->getKid(1))) {
+      if (ce->getZExtValue() >= e->getWidth()) {
+        return false;
+      }
+      return decompose(e->getKid(0), multiplier << ce->getZExtValue(), base,
+                       scale, index);
+    }
+    break;
+  default:
+    break;
+  }
+
+  // Anything else is an opaque index term; only one is supported.
+  if (index.isNull()) {
+    index = e;
+  } else if (index != e) {
+    return false;
+  }
+  scale += multiplier;
+  return true;
+}
+
+void AddressLineSet::bound(const klee::ConstraintManager &constraints,
+                           klee::ref<klee::Expr> index, uint64_t &min,
+                           uint64_t &max) {
+  min = 0;
+  max = klee::bits64::maxValueOfNBits(index->getWidth());
+
+  // Bounds on the unextended value also hold for the extended one.
+  klee::ref<klee::Expr> inner = index;
+  if (index->getKind() == klee::Expr::ZExt) {
+    inner = index->getKid(0);
+    max = klee::bits64::maxValueOfNBits(inner->getWidth());
+  }
+
+  bool empty = false;
+  for (auto c : constraints) {
+    bool negated = false;
+    if (c->getKind() == klee::Expr::Eq) {
+      klee::ConstantExpr *ce = dyn_cast<klee::ConstantExpr>(c->getKid(0));
+      if (!ce || ce->getWidth() > 64) {
+        continue;
+      }
+      if (c->getKid(1) == index || c->getKid(1) == inner) {
+        min = std::max(min, ce->getZExtValue());
+        max = std::min(max, ce->getZExtValue());
+        continue;
+      }
+      if (!ce->isFalse()) {
+        continue;
+      }
+      c = c->getKid(1);
+      negated = true;
+    }
+
+    if (c->getKind() != klee::Expr::Ult && c->getKind() != klee::Expr::Ule) {
+      continue;
+    }
+    bool strict = c->getKind() == klee::Expr::Ult;
+
+    klee::ConstantExpr *ce;
+    if ((c->getKid(0) == index || c->getKid(0) == inner) &&
+        (ce = dyn_cast<klee::ConstantExpr>(c->getKid(1))) &&
+        ce->getWidth() <= 64) {
+      // index < C, index <= C, or their negations.
+      uint64_t v = ce->getZExtValue();
+      if (negated) {
+        if (!strict && v == UINT64_MAX) {
+          empty = true;
+        } else {
+          min = std::max(min, strict ? v : v + 1);
+        }
+      } else {
+        if (strict && v == 0) {
+          empty = true;
+        } else {
+          max = std::min(max, strict ? v - 1 : v);
+        }
+      }
+    } else if ((c->getKid(1) == index || c->getKid(1) == inner) &&
+               (ce = dyn_cast<klee::ConstantExpr>(c->getKid(0))) &&
+               ce->getWidth() <= 64) {
+      // C < index, C <= index, or their negations.
+      uint64_t v = ce->getZExtValue();
+      if (negated) {
+        if (!strict && v == 0) {
+          empty = true;
+        } else {
+          max = std::min(max, strict ? v : v - 1);
+        }
+      } else {
+        if (strict && v == UINT64_MAX) {
+          empty = true;
+        } else {
+          min = std::max(min, strict ? v + 1 : v);
+        }
+      }
+    }
+  }
+
+  if (empty) {
+    min = 1;
+    max = 0;
+  }
+}
+}
@@ -1,7 +1,13 @@
 #include <castan/Internal/ContentionSetCacheModel.h>
 
+#include <castan/Internal/AddressLineSet.h>
+#include <castan/Internal/InstructionCosts.h>
+
 #include <fstream>
+#include <memory>
 
+#include "../Core/CoreStats.h"
+#include "../Core/QueryProfiler.h"
 #include "../Core/TimingSolver.h"
 #include "klee/CommandLine.h"
 #include "klee/Internal/Support/Debug.h"
@@ -30,6 +36,11 @@ llvm::cl::opt<bool> TerminateOnUNSAT(
     llvm::cl::desc("Terminate states where a symbolic pointer doesn't fit the "
                    "cache constraints (default=off)"));
 
+llvm::cl::opt<bool> FastPathSymIndices(
+    "fast-path-sym-indices", llvm::cl::init(true),
+    llvm::cl::desc("Rule out cache lines that an affine symbolic pointer "
+                   "can't reach before asking the solver (default=on)"));
+
 ContentionSetCacheModel::ContentionSetCacheModel() {
   std::ifstream inFile(CACHE_CONTENTIONSETS);
   assert(inFile.good());
@@ -137,6 +148,7 @@ void ContentionSetCacheModel::updateCache(uint64_t address, bool isWrite) {
   if (miss) {
     //     klee::klee_message("  Cache miss for all sets.");
     loopStats.back().missCount++;
+    ++klee::stats::cacheMisses;
   } else {
     //     klee::klee_message("  Cache hit for at least one set.");
     loopStats.back().hitCount++;
@@ -144,6 +156,7 @@ void ContentionSetCacheModel::updateCache(uint64_t address, bool isWrite) {
   if (dirtyMiss) {
     //     klee::klee_message("  Eviction on at least one set.");
     loopStats.back().missCount++;
+    ++klee::stats::cacheMisses;
   }
 }
 
@@ -179,6 +192,8 @@ unsigned long ContentionSetCacheModel::getMissCost(int setIdx, bool isWrite) {
 klee::ref<klee::Expr> ContentionSetCacheModel::memoryOperation(
     klee::Executor *executor, klee::ExecutionState &state,
     klee::ref<klee::Expr> address, bool isWrite) {
+  klee::QueryProfiler::Phase phase(executor->solver->profiler,
+                                   "ContentionSetCacheModel::memoryOperation");
   //       klee::klee_message("Memory %s at %s:%d.", isWrite ? "write" : "read",
   //                          state.pc->info->file.c_str(),
   //                          state.pc->info->line);
@@ -215,6 +230,13 @@ klee::ref<klee::Expr> ContentionSetCacheModel::memoryOperation(
       // Then sort by how many more misses in the set before an eviction.
       // Randomize among equal candidates.
       srand(time(NULL));
+
+      std::unique_ptr<AddressLineSet> lineSet;
+      if (FastPathSymIndices) {
+        lineSet.reset(new AddressLineSet(state.constraints, address,
+                                         BLOCK_BITS, PAGE_BITS));
+      }
+
       // [<<-cycles, - misses till eviction>, rand>] -> setIdx.
       std::map<std::pair<std::pair<long, long>, int>, uint64_t> setCosts;
       for (unsigned int setIdx = 0; setIdx < contentionSets.size(); setIdx++) {
@@ -250,9 +272,8 @@ klee::ref<klee::Expr> ContentionSetCacheModel::memoryOperation(
 
           // Constrain cache line:
           // a == address & ((1<<PAGE_BITS)-1) & ~((1<<BLOCK_BITS)-1)
-          klee::ConstraintManager constraints(state.constraints);
           klee::ref<klee::Expr> e =
-              constraints.simplifyExpr(klee::EqExpr::create(
+              state.constraints.simplifyExpr(klee::EqExpr::create(
                   klee::ConstantExpr::create(a, address->getWidth()),
                   klee::AndExpr::create(
                       klee::ConstantExpr::create(((1 << PAGE_BITS) - 1) &
@@ -265,12 +286,17 @@ klee::ref<klee::Expr> ContentionSetCacheModel::memoryOperation(
             //               klee::klee_message("      Trivially UNSAT.");
             continue;
           }
+          if (lineSet && !lineSet->mayContain(a)) {
+            //               klee::klee_message("      Line unreachable.");
+            continue;
+          }
 
+          klee::ConstraintManager constraints(state.constraints);
           constraints.addConstraint(e);
 
           klee::ref<klee::ConstantExpr> concreteAddress;
-          if (executor->solver->solver->getValue(
-                  klee::Query(constraints, address), concreteAddress)) {
+          if (executor->solver->getValue(state, constraints, address,
+                                         concreteAddress)) {
             //               klee::klee_message("Line fits constraints.");
 
             uint64_t blockAddr =
@@ -349,6 +375,7 @@ klee::ref<klee::Expr> ContentionSetCacheModel::memoryOperation(
     }
   }
 
+  ++klee::stats::cacheAccesses;
   updateCache(dyn_cast<klee::ConstantExpr>(address)->getZExtValue(), isWrite);
   return address;
 }
@@ -391,21 +418,57 @@ bool ContentionSetCacheModel::loop(klee::ExecutionState &state) {
   }
 }
 
+void ContentionSetCacheModel::burst(klee::ExecutionState &state,
+                                    unsigned packets) {
+  if (enabled) {
+    loopStats.back().packetCount = packets;
+  }
+}
+
 void ContentionSetCacheModel::exec(klee::ExecutionState &state) {
   if (enabled) {
     loopStats.back().instructionCount++;
+    loopStats.back().instructionTime +=
+        getInstructionCosts().getCost(state.prevPC->inst, NS_PER_INSTRUCTION);
   }
 }
 
 double ContentionSetCacheModel::getTotalTime() {
   double ns = 0;
-  for (auto it : loopStats) {
-    ns += FIXED_OVERHEAD_NS + it.instructionCount * NS_PER_INSTRUCTION +
-          it.hitCount * CACHE_HIT_LATENCY + it.missCount * CACHE_MISS_LATENCY;
+  for (unsigned i = 0; i < loopStats.size(); i++) {
+    ns += getIterationTime(i);
   }
   return ns;
 }
 
+double ContentionSetCacheModel::getIterationTime(int iteration) {
+  const contentionset_loop_stats_t &it = loopStats[iteration];
+  return getInstructionCosts().getOverhead(FIXED_OVERHEAD_NS) +
+         it.instructionTime + it.hitCount * CACHE_HIT_LATENCY +
+         it.missCount * CACHE_MISS_LATENCY;
+}
+
+void ContentionSetCacheModel::replayLoop() {
+  enabled = 1;
+  loopStats.emplace_back();
+}
+
+void ContentionSetCacheModel::replayAccess(uint64_t address, bool isWrite) {
+  if (isWrite) {
+    loopStats.back().writeCount++;
+  } else {
+    loopStats.back().readCount++;
+  }
+  ++klee::stats::cacheAccesses;
+  updateCache(address, isWrite);
+}
+
+void ContentionSetCacheModel::replayInstructions(unsigned long count) {
+  loopStats.back().instructionCount += count;
+  loopStats.back().instructionTime +=
+      count * getInstructionCosts().getMeanCost(NS_PER_INSTRUCTION);
+}
+
 std::string ContentionSetCacheModel::dumpStats() {
   std::stringstream stats;
 
@@ -417,12 +480,18 @@ std::string ContentionSetCacheModel::dumpStats() {
     stats << "  Cache Hits: " << loopStats[i].hitCount << "\n";
     stats << "  DRAM Accesses: " << loopStats[i].missCount << "\n";
 
-    double ns = getTotalTime();
+    double ns = getIterationTime(i);
     stats << "  Estimated Execution Time: " << ns << " ns\n";
     if (ns) {
       stats << "  Estimated Throughput (Single Core): " << (1e3 / ns)
             << "Mpps\n";
     }
+
+    if (loopStats[i].packetCount > 1) {
+      stats << "  Packets: " << loopStats[i].packetCount << "\n";
+      stats << "  Estimated Execution Time per Packet: "
+            << (ns / loopStats[i].packetCount) << " ns\n";
+    }
   }
 
   return stats.str();
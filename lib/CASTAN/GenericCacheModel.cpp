@@ -1,7 +1,13 @@
 #include <castan/Internal/GenericCacheModel.h>
 
+#include <castan/Internal/AddressLineSet.h>
+#include <castan/Internal/InstructionCosts.h>
+
 #include <fstream>
+#include <memory>
 
+#include "../Core/CoreStats.h"
+#include "../Core/QueryProfiler.h"
 #include "../Core/TimingSolver.h"
 #include "klee/CommandLine.h"
 #include "klee/Internal/Support/Debug.h"
@@ -52,6 +58,8 @@ static struct {
 };
 
 namespace castan {
+extern llvm::cl::opt<bool> FastPathSymIndices;
+
 llvm::cl::opt<bool> WorstCaseSymIndices(
     "worst-case-sym-indices", llvm::cl::init(false),
     llvm::cl::desc("Pick values for symbolic indices that exercise worst case "
@@ -111,6 +119,7 @@ void GenericCacheModel::updateCache(uint64_t address, bool isWrite,
   // Check if accessing beyond last cache (DRAM).
   if (!cacheConfig[level].size) {
     loopStats.back().hitCount[level]++;
+    ++klee::stats::cacheMisses;
     //             klee::klee_message("  DRAM Access at address: %ld.",
     //             address);
     return;
@@ -344,6 +353,8 @@ unsigned long GenericCacheModel::getMissesUntilEviction(uint64_t address) {
 klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
     klee::Executor *executor, klee::ExecutionState &state,
     klee::ref<klee::Expr> address, bool isWrite) {
+  klee::QueryProfiler::Phase phase(executor->solver->profiler,
+                                   "GenericCacheModel::memoryOperation");
   //       klee::klee_message("Memory %s at %s:%d.", isWrite ? "write" : "read",
   //                          state.pc->info->file.c_str(),
   //                          state.pc->info->line);
@@ -384,6 +395,8 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
           enumeratedSets = true;
         }
       }
+      // Built on first use, by the contention set search.
+      std::unique_ptr<AddressLineSet> lineSet;
       // Sort lines by how much damage a miss would cause.
       // Randomize among equal candidates.
       srand(time(NULL));
@@ -449,6 +462,10 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
           klee::klee_message("  Cache line belongs to %d-way slice with %ld "
                              "addresses, of which %ld are already hits.",
                              associativity, addresses.size(), hits.size());
+          if (FastPathSymIndices && !lineSet) {
+            lineSet.reset(new AddressLineSet(state.constraints, address,
+                                             BLOCK_BITS, PAGE_BITS));
+          }
           unsigned int hitCount = hits.size();
           for (long a : addresses) {
             klee::klee_message("    Trying address %08lX.", a);
@@ -459,9 +476,8 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
 
             // Constrain cache line:
             // a == address & ((1<<PAGE_BITS)-1) & ~((1<<BLOCK_BITS)-1)
-            klee::ConstraintManager constraints(state.constraints);
             klee::ref<klee::Expr> e =
-                constraints.simplifyExpr(klee::EqExpr::create(
+                state.constraints.simplifyExpr(klee::EqExpr::create(
                     klee::ConstantExpr::create(a, address->getWidth()),
                     klee::AndExpr::create(
                         klee::ConstantExpr::create(((1 << PAGE_BITS) - 1) &
@@ -474,12 +490,17 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
               //               klee::klee_message("      Trivially UNSAT.");
               continue;
             }
+            if (lineSet && !lineSet->mayContain(a)) {
+              //               klee::klee_message("      Line unreachable.");
+              continue;
+            }
 
+            klee::ConstraintManager constraints(state.constraints);
             constraints.addConstraint(e);
 
             klee::ref<klee::ConstantExpr> concreteAddress;
-            if (executor->solver->solver->getValue(klee::Query(constraints, address),
-                                         concreteAddress)) {
+            if (executor->solver->getValue(state, constraints, address,
+                                           concreteAddress)) {
               //               klee::klee_message("Line fits constraints.");
 
               hitCount++;
@@ -502,9 +523,8 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
         } else {
           // Constrain cache line:
           // (line<<BLOCK_BITS) == ((maxLines-1)<<BLOCK_BITS & address)
-          klee::ConstraintManager constraints(state.constraints);
           klee::ref<klee::Expr> e =
-              constraints.simplifyExpr(klee::EqExpr::create(
+              state.constraints.simplifyExpr(klee::EqExpr::create(
                   klee::ConstantExpr::create(line.second << BLOCK_BITS,
                                              address->getWidth()),
                   klee::AndExpr::create(
@@ -517,6 +537,7 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
             continue;
           }
 
+          klee::ConstraintManager constraints(state.constraints);
           constraints.addConstraint(e);
 
           // Constrain against hit addresses.
@@ -554,8 +575,8 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
           }
 
           klee::ref<klee::ConstantExpr> concreteAddress;
-          if (executor->solver->solver->getValue(klee::Query(constraints, address),
-                                       concreteAddress)) {
+          if (executor->solver->getValue(state, constraints, address,
+                                         concreteAddress)) {
             klee::klee_message("Line fits constraints.");
             state.addConstraint(klee::EqExpr::create(concreteAddress, address));
             address = concreteAddress;
@@ -579,6 +600,7 @@ klee::ref<klee::Expr> GenericCacheModel::memoryOperation(
     }
   }
 
+  ++klee::stats::cacheAccesses;
   updateCache(dyn_cast<klee::ConstantExpr>(address)->getZExtValue(), isWrite,
               0);
   return address;
@@ -622,23 +644,58 @@ bool GenericCacheModel::loop(klee::ExecutionState &state) {
   }
 }
 
+void GenericCacheModel::burst(klee::ExecutionState &state, unsigned packets) {
+  if (enabled) {
+    loopStats.back().packetCount = packets;
+  }
+}
+
 void GenericCacheModel::exec(klee::ExecutionState &state) {
   if (enabled) {
     loopStats.back().instructionCount++;
+    loopStats.back().instructionTime +=
+        getInstructionCosts().getCost(state.prevPC->inst, NS_PER_INSTRUCTION);
   }
 }
 
 double GenericCacheModel::getTotalTime() {
   double ns = 0;
-  for (auto it : loopStats) {
-    ns += FIXED_OVERHEAD_NS + it.instructionCount * NS_PER_INSTRUCTION;
-    for (auto h : it.hitCount) {
-      ns += h.second * cacheConfig[h.first].latency;
-    }
+  for (unsigned i = 0; i < loopStats.size(); i++) {
+    ns += getIterationTime(i);
+  }
+  return ns;
+}
+
+double GenericCacheModel::getIterationTime(int iteration) {
+  double ns = getInstructionCosts().getOverhead(FIXED_OVERHEAD_NS) +
+              loopStats[iteration].instructionTime;
+  for (auto h : loopStats[iteration].hitCount) {
+    ns += h.second * cacheConfig[h.first].latency;
   }
   return ns;
 }
 
+void GenericCacheModel::replayLoop() {
+  enabled = 1;
+  loopStats.emplace_back();
+}
+
+void GenericCacheModel::replayAccess(uint64_t address, bool isWrite) {
+  if (isWrite) {
+    loopStats.back().writeCount++;
+  } else {
+    loopStats.back().readCount++;
+  }
+  ++klee::stats::cacheAccesses;
+  updateCache(address, isWrite, 0);
+}
+
+void GenericCacheModel::replayInstructions(unsigned long count) {
+  loopStats.back().instructionCount += count;
+  loopStats.back().instructionTime +=
+      count * getInstructionCosts().getMeanCost(NS_PER_INSTRUCTION);
+}
+
 std::string GenericCacheModel::dumpStats() {
   std::stringstream stats;
 
@@ -647,21 +704,24 @@ std::string GenericCacheModel::dumpStats() {
     stats << "  Instructions: " << loopStats[i].instructionCount << "\n";
     stats << "  Reads: " << loopStats[i].readCount << "\n";
     stats << "  Writes: " << loopStats[i].writeCount << "\n";
-    double ns =
-        FIXED_OVERHEAD_NS + loopStats[i].instructionCount * NS_PER_INSTRUCTION;
     for (auto h : loopStats[i].hitCount) {
       if (cacheConfig[h.first].size) {
         stats << "  L" << (h.first + 1) << " Hits: " << h.second << "\n";
       } else {
         stats << "  DRAM Accesses: " << h.second << "\n";
       }
-      ns += h.second * cacheConfig[h.first].latency;
     }
+    double ns = getIterationTime(i);
     stats << "  Estimated Execution Time: " << ns << " ns\n";
     if (ns) {
       stats << "  Estimated Throughput (Single Core): " << (1e3 / ns)
             << "Mpps\n";
     }
+    if (loopStats[i].packetCount > 1) {
+      stats << "  Packets: " << loopStats[i].packetCount << "\n";
+      stats << "  Estimated Execution Time per Packet: "
+            << (ns / loopStats[i].packetCount) << " ns\n";
+    }
   }
 
   return stats.str();
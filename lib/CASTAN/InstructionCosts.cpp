@@ -0,0 +1,127 @@
+#include <castan/Internal/InstructionCosts.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "klee/Internal/Support/ErrorHandling.h"
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/Support/CommandLine.h>
+
+namespace castan {
+llvm::cl::opt<std::string> InstructionCostsFile(
+    "instruction-costs",
+    llvm::cl::desc("Table of learned per-opcode and per-basic-block costs, as "
+                   "produced by scripts/perf/learn-instruction-costs.sh "
+                   "(default=flat cost per instruction)"));
+
+void InstructionCosts::load(const std::string &fileName) {
+  std::ifstream file(fileName);
+  if (!file.good()) {
+    klee::klee_error("Unable to open instruction cost table %s.",
+                     fileName.c_str());
+  }
+
+  // LLVM only names opcodes through instructions, so map the names once.
+  std::map<std::string, unsigned> opcodes;
+  for (unsigned opcode = 1; opcode < llvm::Instruction::OtherOpsEnd;
+       opcode++) {
+    opcodes[llvm::Instruction::getOpcodeName(opcode)] = opcode;
+  }
+  opcodeCosts.assign(llvm::Instruction::OtherOpsEnd, -1);
+
+  std::string line;
+  unsigned lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    std::istringstream fields(line);
+    std::string kind;
+    if (!(fields >> kind) || kind[0] == '#') {
+      continue;
+    }
+
+    bool valid = false;
+    if (kind == "opcode") {
+      std::string name;
+      double ns;
+      if ((valid = (fields >> name >> ns) && opcodes.count(name))) {
+        opcodeCosts[opcodes[name]] = ns;
+      }
+    } else if (kind == "block") {
+      std::string function;
+      unsigned index;
+      double ns;
+      if ((valid = (bool)(fields >> function >> index >> ns))) {
+        blockCosts[std::make_pair(function, index)] = ns;
+      }
+    } else if (kind == "overhead") {
+      valid = hasOverhead = (bool)(fields >> overhead);
+    }
+    if (!valid) {
+      klee::klee_error("%s:%d: invalid instruction cost entry.",
+                       fileName.c_str(), lineNumber);
+    }
+  }
+
+  loaded = true;
+  klee::klee_message("Loaded instruction costs from %s.", fileName.c_str());
+}
+
+double InstructionCosts::getBlockCost(const llvm::BasicBlock *bb) {
+  auto it = resolvedBlockCosts.find(bb);
+  if (it != resolvedBlockCosts.end()) {
+    return it->second;
+  }
+
+  const llvm::Function *f = bb->getParent();
+  unsigned index = 0;
+  for (auto bbIt = f->begin(); &*bbIt != bb; ++bbIt) {
+    index++;
+  }
+  auto cost = blockCosts.find(std::make_pair(f->getName().str(), index));
+  return resolvedBlockCosts[bb] =
+             cost == blockCosts.end() ? 0 : cost->second;
+}
+
+double InstructionCosts::getCost(const llvm::Instruction *inst,
+                                 double defaultCost) {
+  if (!loaded) {
+    return defaultCost;
+  }
+
+  double cost = opcodeCosts[inst->getOpcode()];
+  if (cost < 0) {
+    cost = defaultCost;
+  }
+  if (!blockCosts.empty() && inst == &inst->getParent()->front()) {
+    cost += getBlockCost(inst->getParent());
+  }
+  return cost;
+}
+
+double InstructionCosts::getMeanCost(double defaultCost) const {
+  double sum = 0;
+  unsigned count = 0;
+  for (double cost : opcodeCosts) {
+    if (cost >= 0) {
+      sum += cost;
+      count++;
+    }
+  }
+  return count ? sum / count : defaultCost;
+}
+
+InstructionCosts &getInstructionCosts() {
+  static InstructionCosts costs;
+  static bool initialized = false;
+
+  if (!initialized) {
+    initialized = true;
+    if (!InstructionCostsFile.empty()) {
+      costs.load(InstructionCostsFile);
+    }
+  }
+  return costs;
+}
+}
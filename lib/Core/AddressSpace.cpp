@@ -12,8 +12,10 @@
 #include "Memory.h"
 #include "TimingSolver.h"
 
+#include "klee/ExecutionState.h"
 #include "klee/Expr.h"
 #include "klee/TimerStatIncrementer.h"
+#include "klee/util/Bits.h"
 
 using namespace klee;
 
@@ -23,10 +25,13 @@ void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
   objects = objects.replace(std::make_pair(mo, os));
+  allocationEpoch++;
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   objects = objects.remove(mo);
+  // The freed object may be reused for another allocation.
+  resolutions = ResolutionCache();
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
@@ -44,16 +49,78 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
   } else {
     ObjectState *n = new ObjectState(*os);
     n->copyOnWriteOwner = cowKey;
+    size_t bytes = os->getCopySize();
+    stats::cloneBytes += bytes;
+    stats::cloneSizes[bits64::numBits(bytes)]++;
     objects = objects.replace(std::make_pair(mo, n));
     return n;    
   }
 }
 
+///
+
+const ResolutionCacheEntry *
+AddressSpace::lookupResolution(const ExecutionState &state,
+                               ref<Expr> address) const {
+  const ResolutionCache::value_type *res = resolutions.lookup(address);
+  if (!res)
+    return 0;
+
+  const ResolutionCacheEntry &entry = res->second;
+  if (entry.lineage != state.constraints.getLineage())
+    return 0;
+  if (entry.inBoundsBytes)
+    return &entry;
+  if (entry.generation == state.constraints.getGeneration() &&
+      entry.epoch == allocationEpoch)
+    return &entry;
+  return 0;
+}
+
+ResolutionCacheEntry
+AddressSpace::newResolution(const ExecutionState &state) const {
+  ResolutionCacheEntry entry;
+  entry.lineage = state.constraints.getLineage();
+  entry.generation = state.constraints.getGeneration();
+  entry.epoch = allocationEpoch;
+  return entry;
+}
+
+bool AddressSpace::isKnownInBounds(const ExecutionState &state,
+                                   ref<Expr> address, const MemoryObject *mo,
+                                   unsigned bytes) const {
+  if (isa<ConstantExpr>(address))
+    return false;
+  const ResolutionCacheEntry *entry = lookupResolution(state, address);
+  return entry && entry->object == mo && bytes <= entry->inBoundsBytes;
+}
+
+void AddressSpace::recordInBounds(const ExecutionState &state,
+                                  ref<Expr> address, const MemoryObject *mo,
+                                  unsigned bytes) {
+  if (isa<ConstantExpr>(address))
+    return;
+  const ResolutionCacheEntry *old = lookupResolution(state, address);
+  if (old && old->object == mo && bytes <= old->inBoundsBytes)
+    return;
+
+  ResolutionCacheEntry entry = newResolution(state);
+  entry.object = mo;
+  entry.inBoundsBytes = std::max(bytes, old && old->object == mo
+                                            ? old->inBoundsBytes : 0u);
+  entry.complete = true;
+  entry.all.push_back(mo);
+  resolutions = resolutions.replace(std::make_pair(address, entry));
+}
+
 /// 
 
 bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr, 
                               ObjectPair &result) {
-  uint64_t address = addr->getZExtValue();
+  return resolveOne(addr->getZExtValue(), result);
+}
+
+bool AddressSpace::resolveOne(uint64_t address, ObjectPair &result) {
   MemoryObject hack(address);
 
   if (const MemoryMap::value_type *res = objects.lookup_previous(&hack)) {
@@ -78,7 +145,33 @@ bool AddressSpace::resolveOne(ExecutionState &state,
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(address)) {
     success = resolveOne(CE, result);
     return true;
-  } else {
+  }
+
+  const ResolutionCacheEntry *entry = lookupResolution(state, address);
+  if (entry && entry->object) {
+    ++stats::resolutionCacheHits;
+    result = ObjectPair(entry->object, findObject(entry->object));
+    assert(result.second && "cached resolution to unbound object");
+    success = true;
+    return true;
+  }
+
+  if (!resolveOneBySearch(state, solver, address, result, success))
+    return false;
+  if (success) {
+    ResolutionCacheEntry entry = newResolution(state);
+    entry.object = result.first;
+    resolutions = resolutions.replace(std::make_pair(address, entry));
+  }
+  return true;
+}
+
+bool AddressSpace::resolveOneBySearch(ExecutionState &state,
+                                      TimingSolver *solver,
+                                      ref<Expr> address,
+                                      ObjectPair &result,
+                                      bool &success) {
+  {
     TimerStatIncrementer timer(stats::resolveTime);
 
     // try cheap search, will succeed for any inbounds pointer
@@ -171,7 +264,38 @@ bool AddressSpace::resolve(ExecutionState &state,
     if (resolveOne(CE, res))
       rl.push_back(res);
     return false;
-  } else {
+  }
+
+  const ResolutionCacheEntry *entry = lookupResolution(state, p);
+  if (entry && entry->complete &&
+      (!maxResolutions || entry->all.size() < maxResolutions)) {
+    ++stats::resolutionCacheHits;
+    for (unsigned i = 0; i < entry->all.size(); i++)
+      rl.push_back(ObjectPair(entry->all[i], findObject(entry->all[i])));
+    return false;
+  }
+
+  unsigned first = rl.size();
+  if (resolveBySearch(state, solver, p, rl, maxResolutions, timeout))
+    return true;
+
+  ResolutionCacheEntry complete = newResolution(state);
+  complete.complete = true;
+  for (unsigned i = first; i < rl.size(); i++)
+    complete.all.push_back(rl[i].first);
+  if (!complete.all.empty())
+    complete.object = complete.all.front();
+  resolutions = resolutions.replace(std::make_pair(p, complete));
+  return false;
+}
+
+bool AddressSpace::resolveBySearch(ExecutionState &state,
+                                   TimingSolver *solver, 
+                                   ref<Expr> p, 
+                                   ResolutionList &rl, 
+                                   unsigned maxResolutions,
+                                   double timeout) {
+  {
     TimerStatIncrementer timer(stats::resolveTime);
     uint64_t timeout_us = (uint64_t) (timeout*1000000.);
 
@@ -301,7 +425,7 @@ void AddressSpace::copyOutConcretes() {
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
       if (!os->readOnly)
-        memcpy(address, os->concreteStore, mo->size);
+        os->concreteStore.copyOut(address);
     }
   }
 }
@@ -315,12 +439,12 @@ bool AddressSpace::copyInConcretes() {
       const ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (memcmp(address, os->concreteStore, mo->size)!=0) {
+      if (!os->concreteStore.equals(address)) {
         if (os->readOnly) {
           return false;
         } else {
           ObjectState *wos = getWriteable(mo, os);
-          memcpy(wos->concreteStore, address, mo->size);
+          wos->concreteStore.copyIn(address);
         }
       }
     }
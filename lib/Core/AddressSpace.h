@@ -32,12 +32,60 @@ namespace klee {
   };
   
   typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
+
+  /// What the solver found out about the objects a symbolic pointer can
+  /// point to.
+  struct ResolutionCacheEntry {
+    /// The lineage and generation of the constraints the entry was computed
+    /// under (see ConstraintManager).
+    unsigned lineage;
+    unsigned generation;
+    /// The allocation epoch of the address space at the time.
+    unsigned epoch;
+    /// An object the pointer may point to.
+    const MemoryObject *object;
+    /// If non-zero, an access of this many bytes through the pointer must be
+    /// within object. This stays true as constraints are added and objects
+    /// allocated.
+    unsigned inBoundsBytes;
+    /// Every object the pointer may point to, if known.
+    bool complete;
+    std::vector<const MemoryObject*> all;
+
+    ResolutionCacheEntry() : lineage(0), generation(0), epoch(0), object(0),
+                             inBoundsBytes(0), complete(false) {}
+  };
+
+  typedef ImmutableMap<ref<Expr>, ResolutionCacheEntry> ResolutionCache;
   
   class AddressSpace {
   private:
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Resolutions of symbolic pointers, invalidated by frees and, unless
+    /// proven in bounds, by allocations and new constraints.
+    ResolutionCache resolutions;
+
+    /// Incremented on every allocation.
+    unsigned allocationEpoch;
+
+    const ResolutionCacheEntry *lookupResolution(const ExecutionState &state,
+                                                 ref<Expr> address) const;
+    ResolutionCacheEntry newResolution(const ExecutionState &state) const;
+
+    bool resolveOneBySearch(ExecutionState &state,
+                            TimingSolver *solver,
+                            ref<Expr> address,
+                            ObjectPair &result,
+                            bool &success);
+    bool resolveBySearch(ExecutionState &state,
+                         TimingSolver *solver,
+                         ref<Expr> address, 
+                         ResolutionList &rl, 
+                         unsigned maxResolutions,
+                         double timeout);
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace&); 
     
@@ -52,14 +100,17 @@ namespace klee {
     MemoryMap objects;
     
   public:
-    AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace() : cowKey(1), allocationEpoch(0) {}
+    AddressSpace(const AddressSpace &b)
+      : cowKey(++b.cowKey), resolutions(b.resolutions),
+        allocationEpoch(b.allocationEpoch), objects(b.objects) { }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
     /// \return true iff an object was found.
     bool resolveOne(const ref<ConstantExpr> &address, 
                     ObjectPair &result);
+    bool resolveOne(uint64_t address, ObjectPair &result);
 
     /// Resolve address to an ObjectPair in result.
     ///
@@ -89,6 +140,17 @@ namespace klee {
                  unsigned maxResolutions=0,
                  double timeout=0.);
 
+    /// Check whether an access of \a bytes through \a address is already
+    /// known to be within \a mo.
+    bool isKnownInBounds(const ExecutionState &state, ref<Expr> address,
+                         const MemoryObject *mo, unsigned bytes) const;
+
+    /// Remember that an access of \a bytes through \a address was proven
+    /// to be within \a mo, so later resolutions of the same pointer need no
+    /// solver queries.
+    void recordInBounds(const ExecutionState &state, ref<Expr> address,
+                        const MemoryObject *mo, unsigned bytes);
+
     /***/
 
     /// Add a binding to the address space.
@@ -12,6 +12,10 @@
 using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::cacheAccesses("CacheAccesses", "CAcc");
+Statistic stats::cacheMisses("CacheMisses", "CMiss");
+Statistic stats::cloneBytes("CloneBytes", "CloneB");
+uint64_t stats::cloneSizes[65];
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
@@ -23,6 +27,8 @@ Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::resolutionCacheHits("ResolutionCacheHits", "RChits");
+Statistic stats::compactedUpdates("CompactedUpdates", "CUpd");
 Statistic stats::solverTime("SolverTime", "Stime");
 Statistic stats::states("States", "States");
 Statistic stats::trueBranches("TrueBranches", "Bt");
@@ -17,6 +17,8 @@ namespace stats {
 
   extern Statistic allocations;
   extern Statistic resolveTime;
+  extern Statistic resolutionCacheHits;
+  extern Statistic compactedUpdates;
   extern Statistic instructions;
   extern Statistic instructionTime;
   extern Statistic instructionRealTime;
@@ -27,6 +29,18 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// Memory accesses simulated by the cache model, and those of them that
+  /// reached DRAM.
+  extern Statistic cacheAccesses;
+  extern Statistic cacheMisses;
+
+  /// Bytes of objects copied to give a state its own writeable copy.
+  extern Statistic cloneBytes;
+
+  /// Writeable copies by the number of bits in the bytes they copied, so
+  /// that cloneSizes[i] counts copies of less than 2^i bytes.
+  extern uint64_t cloneSizes[65];
+
   /// The number of process forks.
   extern Statistic forks;
 
@@ -18,6 +18,8 @@
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "MetricsTracker.h"
+#include "QueryProfiler.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -45,8 +47,10 @@
 #include "klee/Internal/Module/KModule.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/Internal/Support/FloatEvaluation.h"
+#include "klee/Internal/Support/IntEvaluation.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/SpillArena.h"
 #include "klee/SolverStats.h"
 
 #include "castan/Internal/CacheModel.h"
@@ -119,6 +123,25 @@ using namespace klee;
 
 
 namespace {
+  cl::opt<bool>
+  ProfileQueries("profile-queries",
+                 cl::init(false),
+                 cl::desc("Attribute solver time to analysis phases and source lines, writing queries.folded and queries.prof (default=off)"));
+
+  cl::opt<bool>
+  FastForwardInit("fast-forward-init",
+                  cl::init(true),
+                  cl::desc("Step the initial state without a searcher until it first forks or enables the cache model (default=on)"));
+
+  cl::opt<std::string>
+  SpillDir("spill-dir",
+           cl::desc("Back the pages of large objects with a file in this directory, letting the kernel write out the least recently used ones instead of states being killed at the memory cap, which then only counts the resident part"));
+
+  cl::opt<unsigned>
+  CompactUpdatesThreshold("compact-updates-threshold",
+                          cl::init(64),
+                          cl::desc("At each castan_loop(), compact the update lists of objects with more writes than this (default=64, 0=off)"));
+
   cl::opt<bool>
   DumpStatesOnHalt("dump-states-on-halt",
                    cl::init(false),
@@ -352,6 +375,7 @@ const char *Executor::TerminateReasonNames[] = {
 Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
     : Interpreter(opts), kmodule(0), interpreterHandler(ih), searcher(0),
       externalDispatcher(new ExternalDispatcher()), statsTracker(0),
+      metricsTracker(0),
       pathWriter(0), symPathWriter(0), specialFunctionHandler(0),
       processTree(0), replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
@@ -359,9 +383,16 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
       coreSolverTimeout(MaxCoreSolverTime != 0 && MaxInstructionTime != 0
                             ? std::min(MaxCoreSolverTime, MaxInstructionTime)
                             : std::max(MaxCoreSolverTime, MaxInstructionTime)),
-      debugInstFile(0), debugLogBuffer(debugBufferString) {
+      debugInstFile(0), debugLogBuffer(debugBufferString),
+      initSnapshotPending(false) {
 
   if (coreSolverTimeout) UseForkedCoreSolver = true;
+  if (!SpillDir.empty()) {
+    std::string error;
+    if (!util::EnableSpillArena(SpillDir, error))
+      klee_error("Could not create a spill file in %s: %s", SpillDir.c_str(),
+                 error.c_str());
+  }
   Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
   if (!coreSolver) {
     klee_error("Failed to create core solver\n");
@@ -374,6 +405,10 @@ Executor::Executor(const InterpreterOptions &opts, InterpreterHandler *ih)
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME));
 
   this->solver = new TimingSolver(solver, EqualitySubstitution);
+  // Metrics count queries by origin, which the profiler does cheaply when
+  // not profiling in detail.
+  if (ProfileQueries || MetricsTracker::useMetrics())
+    this->solver->profiler = new QueryProfiler(ProfileQueries);
   memory = new MemoryManager(&arrayCache);
 
   if (optionIsSet(DebugPrintInstructions, FILE_ALL) ||
@@ -434,6 +469,9 @@ const Module *Executor::setModule(llvm::Module *module,
                        interpreterHandler->getOutputFilename("assembly.ll"),
                        userSearcherRequiresMD2U());
   }
+
+  if (MetricsTracker::useMetrics())
+    metricsTracker = new MetricsTracker(*this);
   
   return module;
 }
@@ -443,6 +481,18 @@ const Module *Executor::getModule() {
 }
 
 Executor::~Executor() {
+  if (solver->profiler && solver->profiler->isDetailed()) {
+    if (llvm::raw_fd_ostream *f =
+            interpreterHandler->openOutputFile("queries.folded")) {
+      solver->profiler->writeFolded(*f);
+      delete f;
+    }
+    if (llvm::raw_fd_ostream *f =
+            interpreterHandler->openOutputFile("queries.prof")) {
+      solver->profiler->writeHistograms(*f);
+      delete f;
+    }
+  }
   delete memory;
   delete externalDispatcher;
   if (processTree)
@@ -451,6 +501,7 @@ Executor::~Executor() {
     delete specialFunctionHandler;
   if (statsTracker)
     delete statsTracker;
+  delete metricsTracker;
   delete solver;
   delete kmodule;
   while(!timers.empty()) {
@@ -526,6 +577,7 @@ MemoryObject * Executor::addExternalObject(ExecutionState &state,
     os->write8(i, ((uint8_t*)addr)[i]);
   if(isReadOnly)
     os->setReadOnly(true);  
+  externalObjects.push_back(mo);
   return mo;
 }
 
@@ -779,6 +831,7 @@ void Executor::branch(ExecutionState &state,
 
 Executor::StatePair 
 Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
+  QueryProfiler::Phase phase(solver->profiler, "Executor::fork");
   Solver::Validity res;
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&current);
@@ -1118,12 +1171,247 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, 
                          ref<Expr> value) {
-  getDestCell(state, target).value = value;
+  getDestCell(state, target).setValue(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, 
                             ExecutionState &state, ref<Expr> value) {
-  getArgumentCell(state, kf, index).value = value;
+  getArgumentCell(state, kf, index).setValue(value);
+}
+
+bool Executor::executeImmediateInstruction(ExecutionState &state,
+                                           KInstruction *ki) {
+  Instruction *i = ki->inst;
+  unsigned opcode = i->getOpcode();
+
+  switch (opcode) {
+  case Instruction::Br: {
+    BranchInst *bi = cast<BranchInst>(i);
+    // Unconditional branches are already cheap. Seeding, path replay and
+    // path recording all need to see the branch in fork.
+    if (bi->isUnconditional() || replayPath || pathWriter || !seedMap.empty())
+      return false;
+    const Cell &cond = eval(ki, 0, state);
+    if (!cond.isImmediate())
+      return false;
+    bool taken = cond.getImmediate();
+
+    if (statsTracker && state.stack.back().kf->trackCoverage)
+      statsTracker->markBranchVisited(taken ? &state : 0, taken ? 0 : &state);
+    transferToBasicBlock(bi->getSuccessor(taken ? 0 : 1), bi->getParent(),
+                         state);
+    return true;
+  }
+  case Instruction::Load:
+    return executeImmediateMemoryOperation(state, false, ki);
+  case Instruction::Store:
+    return executeImmediateMemoryOperation(state, true, ki);
+  case Instruction::GetElementPtr: {
+    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+    Expr::Width pointerWidth = Context::get().getPointerWidth();
+    const Cell &base = eval(ki, 0, state);
+    if (!base.isImmediate())
+      return false;
+    uint64_t result = base.getImmediate();
+
+    for (std::vector< std::pair<unsigned, uint64_t> >::iterator
+           it = kgepi->indices.begin(), ie = kgepi->indices.end();
+         it != ie; ++it) {
+      const Cell &index = eval(ki, it->first, state);
+      if (!index.isImmediate() || index.getWidth() > pointerWidth)
+        return false;
+      uint64_t offset = ints::mul(ints::sext(index.getImmediate(), pointerWidth,
+                                             index.getWidth()),
+                                  it->second, pointerWidth);
+      result = ints::add(result, offset, pointerWidth);
+    }
+    if (kgepi->offset)
+      result = ints::add(result, kgepi->offset, pointerWidth);
+    getDestCell(state, ki).setImmediate(result, pointerWidth);
+    return true;
+  }
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::ICmp:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    break;
+  default:
+    return false;
+  }
+
+  const Cell &left = eval(ki, 0, state);
+  if (!left.isImmediate())
+    return false;
+  uint64_t l = left.getImmediate();
+  Expr::Width width = left.getWidth();
+
+  if (CastInst *ci = dyn_cast<CastInst>(i)) {
+    Expr::Width outWidth = getWidthForLLVMType(ci->getType());
+    if (outWidth > 64)
+      return false;
+
+    uint64_t result;
+    switch (opcode) {
+    case Instruction::Trunc:
+      result = ints::trunc(l, outWidth, width);
+      break;
+    case Instruction::ZExt:
+      result = ints::zext(l, outWidth, width);
+      break;
+    default:
+      result = ints::sext(l, outWidth, width);
+      break;
+    }
+    getDestCell(state, ki).setImmediate(result, outWidth);
+    return true;
+  }
+
+  const Cell &right = eval(ki, 1, state);
+  if (!right.isImmediate())
+    return false;
+  uint64_t r = right.getImmediate();
+  assert(right.getWidth() == width && "operand width mismatch");
+
+  uint64_t result;
+  Expr::Width resultWidth = width;
+  switch (opcode) {
+  case Instruction::Add: result = ints::add(l, r, width); break;
+  case Instruction::Sub: result = ints::sub(l, r, width); break;
+  case Instruction::Mul: result = ints::mul(l, r, width); break;
+  case Instruction::And: result = ints::land(l, r, width); break;
+  case Instruction::Or: result = ints::lor(l, r, width); break;
+  case Instruction::Xor: result = ints::lxor(l, r, width); break;
+
+  // Leave division by zero and signed overflow to the general path.
+  case Instruction::UDiv:
+  case Instruction::URem:
+    if (r == 0)
+      return false;
+    result = opcode == Instruction::UDiv ? ints::udiv(l, r, width)
+                                         : ints::urem(l, r, width);
+    break;
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    if (r == 0 || r == bits64::maxValueOfNBits(width))
+      return false;
+    result = opcode == Instruction::SDiv ? ints::sdiv(l, r, width)
+                                         : ints::srem(l, r, width);
+    break;
+
+  // Likewise for over-wide shifts.
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    if (r >= width)
+      return false;
+    if (opcode == Instruction::Shl)
+      result = ints::shl(l, r, width);
+    else if (opcode == Instruction::LShr)
+      result = ints::lshr(l, r, width);
+    else
+      result = ints::ashr(l, r, width);
+    break;
+
+  case Instruction::ICmp:
+    resultWidth = Expr::Bool;
+    switch (cast<ICmpInst>(i)->getPredicate()) {
+    case ICmpInst::ICMP_EQ: result = ints::eq(l, r, width); break;
+    case ICmpInst::ICMP_NE: result = ints::ne(l, r, width); break;
+    case ICmpInst::ICMP_UGT: result = ints::ugt(l, r, width); break;
+    case ICmpInst::ICMP_UGE: result = ints::uge(l, r, width); break;
+    case ICmpInst::ICMP_ULT: result = ints::ult(l, r, width); break;
+    case ICmpInst::ICMP_ULE: result = ints::ule(l, r, width); break;
+    case ICmpInst::ICMP_SGT: result = ints::sgt(l, r, width); break;
+    case ICmpInst::ICMP_SGE: result = ints::sge(l, r, width); break;
+    case ICmpInst::ICMP_SLT: result = ints::slt(l, r, width); break;
+    case ICmpInst::ICMP_SLE: result = ints::sle(l, r, width); break;
+    default:
+      return false;
+    }
+    break;
+
+  default:
+    return false;
+  }
+
+  getDestCell(state, ki).setImmediate(result, resultWidth);
+  return true;
+}
+
+bool Executor::executeImmediateMemoryOperation(ExecutionState &state,
+                                               bool isWrite,
+                                               KInstruction *ki) {
+  // The cache model needs the address expressions of every access once it is
+  // enabled, and replacing reads with symbolics needs the expression path.
+  if (state.cacheModel && state.cacheModel->isEnabled())
+    return false;
+  if (!isWrite && interpreterOpts.MakeConcreteSymbolic)
+    return false;
+
+  const Cell &address = eval(ki, isWrite ? 1 : 0, state);
+  if (!address.isImmediate())
+    return false;
+
+  Expr::Width type;
+  uint64_t value = 0;
+  if (isWrite) {
+    const Cell &stored = eval(ki, 0, state);
+    if (!stored.isImmediate())
+      return false;
+    type = stored.getWidth();
+    value = stored.getImmediate();
+  } else {
+    type = getWidthForLLVMType(ki->inst->getType());
+  }
+  if (type > 64 || (type != Expr::Bool && type % 8))
+    return false;
+  unsigned bytes = Expr::getMinBytesForWidth(type);
+
+  // Anything but a single in-bounds object, including errors, goes through
+  // executeMemoryOperation.
+  ObjectPair op;
+  if (!state.addressSpace.resolveOne(address.getImmediate(), op))
+    return false;
+  const MemoryObject *mo = op.first;
+  uint64_t offset = address.getImmediate() - mo->address;
+  if (offset + bytes > mo->size)
+    return false;
+
+  const ObjectState *os = op.second;
+  if (isWrite) {
+    if (os->readOnly)
+      return false;
+    ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+    switch (type) {
+    case Expr::Bool:
+    case Expr::Int8: wos->write8(offset, value); break;
+    case Expr::Int16: wos->write16(offset, value); break;
+    case Expr::Int32: wos->write32(offset, value); break;
+    case Expr::Int64: wos->write64(offset, value); break;
+    default:
+      wos->write(offset, ConstantExpr::create(value, type));
+      break;
+    }
+  } else {
+    uint64_t result;
+    if (!os->readConcrete(offset, type, result))
+      return false;
+    getDestCell(state, ki).setImmediate(result, type);
+  }
+  return true;
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1152,6 +1440,7 @@ ref<klee::ConstantExpr>
 Executor::toConstant(ExecutionState &state, 
                      ref<Expr> e,
                      const char *reason) {
+  QueryProfiler::Phase phase(solver->profiler, "Executor::toConstant");
   e = state.constraints.simplifyExpr(e);
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
     return CE;
@@ -1536,6 +1825,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     state.cacheModel->exec(state);
   }
 
+  if (executeImmediateInstruction(state, ki))
+    return;
+
   Instruction *i = ki->inst;
   switch (i->getOpcode()) {
     // Control flow
@@ -1547,7 +1839,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
     
     if (!isVoidReturn) {
-      result = eval(ki, 0, state).value;
+      result = eval(ki, 0, state).getValue();
     }
     
     if (state.stack.size() <= 1) {
@@ -1636,7 +1928,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // FIXME: Find a way that we don't have this hidden dependency.
       assert(bi->getCondition() == bi->getOperand(0) &&
              "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
+      ref<Expr> cond = eval(ki, 0, state).getValue();
       Executor::StatePair branches = fork(state, cond, false);
 
       // NOTE: There is a hidden dependency here, markBranchVisited
@@ -1655,7 +1947,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::Switch: {
     SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
     BasicBlock *bb = si->getParent();
 
     cond = toUnique(state, cond);
@@ -1808,7 +2100,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     arguments.reserve(numArgs);
 
     for (unsigned j=0; j<numArgs; ++j)
-      arguments.push_back(eval(ki, j+1, state).value);
+      arguments.push_back(eval(ki, j+1, state).getValue());
 
     if (f) {
       const FunctionType *fType = 
@@ -1855,7 +2147,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
       executeCall(state, ki, f, arguments);
     } else {
-      ref<Expr> v = eval(ki, 0, state).value;
+      ref<Expr> v = eval(ki, 0, state).getValue();
 
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
@@ -1897,9 +2189,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::PHI: {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-    ref<Expr> result = eval(ki, state.incomingBBIndex, state).value;
+    ref<Expr> result = eval(ki, state.incomingBBIndex, state).getValue();
 #else
-    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
+    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).getValue();
 #endif
     bindLocal(ki, state, result);
     break;
@@ -1907,9 +2199,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Special instructions
   case Instruction::Select: {
-    ref<Expr> cond = eval(ki, 0, state).value;
-    ref<Expr> tExpr = eval(ki, 1, state).value;
-    ref<Expr> fExpr = eval(ki, 2, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
+    ref<Expr> tExpr = eval(ki, 1, state).getValue();
+    ref<Expr> fExpr = eval(ki, 2, state).getValue();
     ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
     bindLocal(ki, state, result);
     break;
@@ -1922,101 +2214,101 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Arithmetic / logical
 
   case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     bindLocal(ki, state, AddExpr::create(left, right));
     break;
   }
 
   case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     bindLocal(ki, state, SubExpr::create(left, right));
     break;
   }
  
   case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     bindLocal(ki, state, MulExpr::create(left, right));
     break;
   }
 
   case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = UDivExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = SDivExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = URemExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
  
   case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = SRemExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = AndExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = OrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = XorExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = ShlExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = LShrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = AShrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -2030,80 +2322,80 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
  
     switch(ii->getPredicate()) {
     case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = EqExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = NeExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UgtExpr::create(left, right);
       bindLocal(ki, state,result);
       break;
     }
 
     case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UgeExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UltExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UleExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SgtExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SgeExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SltExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SleExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
@@ -2122,7 +2414,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
     ref<Expr> size = Expr::createPointer(elementSize);
     if (ai->isArrayAllocation()) {
-      ref<Expr> count = eval(ki, 0, state).value;
+      ref<Expr> count = eval(ki, 0, state).getValue();
       count = Expr::createZExtToPointerWidth(count);
       size = MulExpr::create(size, count);
     }
@@ -2131,7 +2423,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::Load: {
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
     if (state.cacheModel) {
       base = state.cacheModel->load(this, state, base);
     }
@@ -2139,8 +2431,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     break;
   }
   case Instruction::Store: {
-    ref<Expr> base = eval(ki, 1, state).value;
-    ref<Expr> value = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 1, state).getValue();
+    ref<Expr> value = eval(ki, 0, state).getValue();
     if (state.cacheModel) {
       base = state.cacheModel->store(this, state, base);
     }
@@ -2150,13 +2442,13 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
   case Instruction::GetElementPtr: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
 
     for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
            it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
          it != ie; ++it) {
       uint64_t elementSize = it->second;
-      ref<Expr> index = eval(ki, it->first, state).value;
+      ref<Expr> index = eval(ki, it->first, state).getValue();
       base = AddExpr::create(base,
                              MulExpr::create(Expr::createSExtToPointerWidth(index),
                                              Expr::createPointer(elementSize)));
@@ -2171,7 +2463,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Conversion
   case Instruction::Trunc: {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
+    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).getValue(),
                                            0,
                                            getWidthForLLVMType(ci->getType()));
     bindLocal(ki, state, result);
@@ -2179,14 +2471,14 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::ZExt: {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
+    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).getValue(),
                                         getWidthForLLVMType(ci->getType()));
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
     CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
+    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).getValue(),
                                         getWidthForLLVMType(ci->getType()));
     bindLocal(ki, state, result);
     break;
@@ -2195,20 +2487,20 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::IntToPtr: {
     CastInst *ci = cast<CastInst>(i);
     Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     bindLocal(ki, state, ZExtExpr::create(arg, pType));
     break;
   } 
   case Instruction::PtrToInt: {
     CastInst *ci = cast<CastInst>(i);
     Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     bindLocal(ki, state, ZExtExpr::create(arg, iType));
     break;
   }
 
   case Instruction::BitCast: {
-    ref<Expr> result = eval(ki, 0, state).value;
+    ref<Expr> result = eval(ki, 0, state).getValue();
     bindLocal(ki, state, result);
     break;
   }
@@ -2216,9 +2508,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Floating point instructions
 
   case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2236,9 +2528,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2255,9 +2547,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
  
   case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2275,9 +2567,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2295,9 +2587,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FRem: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2317,7 +2609,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPTrunc: {
     FPTruncInst *fi = cast<FPTruncInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
       return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
@@ -2338,7 +2630,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPExt: {
     FPExtInst *fi = cast<FPExtInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
       return terminateStateOnExecError(state, "Unsupported FPExt operation");
@@ -2358,7 +2650,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPToUI: {
     FPToUIInst *fi = cast<FPToUIInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToUI operation");
@@ -2379,7 +2671,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPToSI: {
     FPToSIInst *fi = cast<FPToSIInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToSI operation");
@@ -2400,7 +2692,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::UIToFP: {
     UIToFPInst *fi = cast<UIToFPInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -2416,7 +2708,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::SIToFP: {
     SIToFPInst *fi = cast<SIToFPInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -2431,9 +2723,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
   case Instruction::FCmp: {
     FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2529,8 +2821,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::InsertValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
-    ref<Expr> val = eval(ki, 1, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
+    ref<Expr> val = eval(ki, 1, state).getValue();
 
     ref<Expr> l = NULL, r = NULL;
     unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
@@ -2556,7 +2848,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::ExtractValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
 
     ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
 
@@ -2668,7 +2960,7 @@ void Executor::bindModuleConstants() {
   kmodule->constantTable = new Cell[kmodule->constants.size()];
   for (unsigned i=0; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+    c.setValue(evalConstant(kmodule->constants[i]));
   }
 }
 
@@ -2679,8 +2971,11 @@ void Executor::checkMemoryUsage() {
     // We need to avoid calling GetTotalMallocUsage() often because it
     // is O(elts on freelist). This is really bad since we start
     // to pummel the freelist once we hit the memory cap.
+    // Only the resident part of the spill file counts: the rest is what
+    // the kernel wrote out to keep the process under the cap.
     unsigned mbs = (util::GetTotalMallocUsage() >> 20) +
-                   (memory->getUsedDeterministicSize() >> 20);
+                   (memory->getUsedDeterministicSize() >> 20) +
+                   (util::GetSpillArenaResidentUsage() >> 20);
 
     if (mbs > MaxMemory) {
       if (mbs > MaxMemory + 100) {
@@ -2799,6 +3094,26 @@ void Executor::run(ExecutionState &initialState) {
     }
   }
 
+  // The initialization before the first loop iteration usually runs
+  // concretely on a single state, so there is nothing to search yet.
+  if (FastForwardInit && !usingSeeds) {
+    ExecutionState &state = initialState;
+    while (states.size() == 1 && !haltExecution &&
+           !(state.cacheModel && state.cacheModel->isEnabled())) {
+      KInstruction *ki = state.pc;
+      stepInstruction(state);
+
+      executeInstruction(state, ki);
+      processTimers(&state, MaxInstructionTime);
+
+      checkMemoryUsage();
+
+      if (!addedStates.empty() || !removedStates.empty())
+        break;
+    }
+    updateStates(0);
+  }
+
   searcher = constructUserSearcher(*this);
 
   std::vector<ExecutionState *> newStates(states.begin(), states.end());
@@ -3339,6 +3654,8 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
+  QueryProfiler::Phase phase(solver->profiler,
+                             "Executor::executeMemoryOperation");
   Expr::Width type = (isWrite ? value->getWidth() : 
                      getWidthForLLVMType(target->inst->getType()));
   unsigned bytes = Expr::getMinBytesForWidth(type);
@@ -3378,16 +3695,21 @@ void Executor::executeMemoryOperation(ExecutionState &state,
     
     ref<Expr> offset = mo->getOffsetExpr(address);
 
-    bool inBounds;
-    solver->setTimeout(coreSolverTimeout);
-    bool success = solver->mustBeTrue(state, 
-                                      mo->getBoundsCheckOffset(offset, bytes),
-                                      inBounds);
-    solver->setTimeout(0);
-    if (!success) {
-      state.pc = state.prevPC;
-      terminateStateEarly(state, "Query timed out (bounds check).");
-      return;
+    bool inBounds = state.addressSpace.isKnownInBounds(state, address, mo,
+                                                       bytes);
+    if (!inBounds) {
+      solver->setTimeout(coreSolverTimeout);
+      bool success = solver->mustBeTrue(state, 
+                                        mo->getBoundsCheckOffset(offset, bytes),
+                                        inBounds);
+      solver->setTimeout(0);
+      if (!success) {
+        state.pc = state.prevPC;
+        terminateStateEarly(state, "Query timed out (bounds check).");
+        return;
+      }
+      if (inBounds)
+        state.addressSpace.recordInBounds(state, address, mo, bytes);
     }
 
     if (inBounds) {
@@ -3465,6 +3787,32 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   }
 }
 
+void Executor::compactUpdateLists(ExecutionState &state) {
+  if (!CompactUpdatesThreshold)
+    return;
+
+  // Only lists that grew by the threshold since they were last compacted
+  // are worth the simplification.
+  std::vector<ObjectPair> candidates;
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+         ie = state.addressSpace.objects.end(); it != ie; ++it) {
+    const ObjectState *os = it->second;
+    if (os->shouldCompactUpdates(CompactUpdatesThreshold))
+      candidates.push_back(std::make_pair(it->first, os));
+  }
+
+  for (std::vector<ObjectPair>::iterator it = candidates.begin(),
+         ie = candidates.end(); it != ie; ++it) {
+    UpdateList compacted(0, 0);
+    if (!it->second->compactUpdates(state.constraints, compacted))
+      continue;
+    // Compact a private copy: the constraints are only valid for this state.
+    ObjectState *wos = state.addressSpace.getWriteable(it->first, it->second);
+    stats::compactedUpdates += wos->getNumUpdates() - compacted.getSize();
+    wos->setCompactedUpdates(compacted);
+  }
+}
+
 void Executor::executeMakeSymbolic(ExecutionState &state, 
                                    const MemoryObject *mo,
                                    const std::string &name) {
@@ -3629,6 +3977,10 @@ void Executor::runFunctionAsMain(Function *f,
   
   initializeGlobals(*state);
 
+  setupInitSnapshot(argc, argv, envp);
+  if (restoreInitSnapshot(*state))
+    klee_message("resuming from init snapshot %s", initSnapshotPath.c_str());
+
   processTree = new PTree(state);
   state->ptreeNode = processTree->root;
   run(*state);
@@ -3644,6 +3996,8 @@ void Executor::runFunctionAsMain(Function *f,
 
   if (statsTracker)
     statsTracker->done();
+  if (metricsTracker)
+    metricsTracker->done();
 }
 
 unsigned Executor::getPathStreamID(const ExecutionState &state) {
@@ -3697,6 +4051,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
                                    std::pair<std::string,
                                    std::vector<unsigned char> > >
                                    &res) {
+  QueryProfiler::Phase phase(solver->profiler, "Executor::getSymbolicSolution");
   solver->setTimeout(coreSolverTimeout);
 
   ExecutionState tmp(state);
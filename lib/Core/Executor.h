@@ -63,6 +63,7 @@ namespace klee {
   class KModule;
   class MemoryManager;
   class MemoryObject;
+  class MetricsTracker;
   class ObjectState;
   class PTree;
   class Searcher;
@@ -88,6 +89,7 @@ class Executor : public Interpreter {
   friend class WeightedRandomSearcher;
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
+  friend class MetricsTracker;
 
 public:
   class Timer {
@@ -132,6 +134,7 @@ private:
   MemoryManager *memory;
   std::set<ExecutionState*> states;
   StatsTracker *statsTracker;
+  MetricsTracker *metricsTracker;
   TreeStreamWriter *pathWriter, *symPathWriter;
   SpecialFunctionHandler *specialFunctionHandler;
   std::vector<TimerInfo*> timers;
@@ -168,6 +171,10 @@ private:
   /// pointers. We use the actual Function* address as the function address.
   std::set<uint64_t> legalFunctions;
 
+  /// Objects bound by addExternalObject, in creation order. They live at
+  /// host addresses, which change between runs.
+  std::vector<const MemoryObject *> externalObjects;
+
   /// When non-null the bindings that will be used for calls to
   /// klee_make_symbolic in order replay.
   const struct KTest *replayKTest;
@@ -212,6 +219,13 @@ private:
   // @brief buffer to store logs before flushing to file
   llvm::raw_string_ostream debugLogBuffer;
 
+  /// Snapshot of the state at the first castan_loop() for this module and
+  /// these arguments, or empty if snapshots are disabled.
+  std::string initSnapshotPath;
+
+  /// Whether this run still has to write the snapshot.
+  bool initSnapshotPending;
+
   llvm::Function* getTargetFunction(llvm::Value *calledVal,
                                     ExecutionState &state);
   
@@ -232,6 +246,17 @@ private:
 			      unsigned offset);
   void initializeGlobals(ExecutionState &state);
 
+  /// Compute \ref initSnapshotPath from the module and program arguments.
+  void setupInitSnapshot(int argc, char **argv, char **envp);
+
+  /// Save the state reaching the first castan_loop(), provided it is the
+  /// only one and fully concrete.
+  void saveInitSnapshot(ExecutionState &state);
+
+  /// Replace the freshly initialized state with the saved snapshot.
+  /// \return false if there is no usable snapshot.
+  bool restoreInitSnapshot(ExecutionState &state);
+
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
@@ -305,6 +330,11 @@ private:
                               ref<Expr> value /* undef if read */,
                               KInstruction *target /* undef if write */);
 
+  /// Compact the long update lists in the address space of a state, so
+  /// that reads of tables written at symbolic indices every loop iteration
+  /// do not grow without bound.
+  void compactUpdateLists(ExecutionState &state);
+
   void executeMakeSymbolic(ExecutionState &state, const MemoryObject *mo,
                            const std::string &name);
 
@@ -353,6 +383,18 @@ private:
                     ExecutionState &state,
                     ref<Expr> value);
 
+  /// Execute integer arithmetic, comparisons, casts, address computations,
+  /// conditional branches and concrete loads and stores whose operands are
+  /// immediate cells directly on the inline values. Returns false if the
+  /// instruction has to go through the general, expression-based path.
+  bool executeImmediateInstruction(ExecutionState &state, KInstruction *ki);
+
+  /// Perform a load or store at an immediate address that falls within a
+  /// single object without building expressions. Returns false if the access
+  /// is symbolic, out of bounds or otherwise needs executeMemoryOperation.
+  bool executeImmediateMemoryOperation(ExecutionState &state, bool isWrite,
+                                       KInstruction *ki);
+
   ref<klee::ConstantExpr> evalConstantExpr(const llvm::ConstantExpr *ce);
 
   /// Return a unique constant value for the given expression in the
@@ -0,0 +1,641 @@
+//===-- ExecutorSnapshot.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Snapshots of the state reaching the first castan_loop(). NF initialization
+// (table fills, route loading, ...) is deterministic for a given module and
+// arguments, so the first run saves the address space and stack at that
+// point and later runs resume from there.
+//
+// The format is host-specific: objects are restored at their original
+// addresses, which requires deterministic allocation. Function addresses and
+// the external objects (errno, ctype tables) are host addresses that move
+// between runs, so pointers to them are relocated on restore.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Executor.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+#include "StatsTracker.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/Module/Cell.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Interpreter.h"
+
+#include "castan/Internal/CacheModel.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#else
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#endif
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<std::string>
+  InitSnapshotDir("init-snapshot-dir",
+                  cl::desc("Save the state at the first castan_loop() in this directory, and resume from it in later runs with the same module and arguments (requires --allocate-determ)"));
+}
+
+static const char snapshotMagic[8] = { 'C', 'A', 'S', 'T', 'S', 'N', 'P', '2' };
+
+/// FNV-1a, which unlike the LLVM hashing is stable across processes.
+static uint64_t hashBytes(uint64_t hash, const char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash ^= (uint8_t) data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char *s) {
+  // Include the terminator so that argument boundaries count.
+  return hashBytes(hash, s, strlen(s) + 1);
+}
+
+/// Index of ki within the instructions of kf, or kf->numInstructions.
+static unsigned getInstructionIndex(const KFunction *kf,
+                                    const KInstruction *ki) {
+  unsigned i = 0;
+  while (i < kf->numInstructions && kf->instructions[i] != ki)
+    i++;
+  return i;
+}
+
+namespace {
+  class SnapshotWriter {
+    raw_ostream &os;
+
+  public:
+    SnapshotWriter(raw_ostream &_os) : os(_os) {}
+
+    template <typename T> void write(T value) {
+      os.write((const char *) &value, sizeof(value));
+    }
+    void write(const std::string &s) {
+      write<uint32_t>(s.size());
+      os << s;
+    }
+  };
+
+  class SnapshotReader {
+    const char *pos, *end;
+
+  public:
+    bool ok;
+
+    SnapshotReader(const char *_pos, const char *_end)
+      : pos(_pos), end(_end), ok(true) {}
+
+    /// Returns a pointer to the next size bytes, or null past the end.
+    const char *take(size_t size) {
+      if (!ok || (size_t) (end - pos) < size) {
+        ok = false;
+        return 0;
+      }
+      const char *result = pos;
+      pos += size;
+      return result;
+    }
+
+    template <typename T> T read() {
+      T value = T();
+      if (const char *p = take(sizeof(value)))
+        memcpy(&value, p, sizeof(value));
+      return value;
+    }
+    std::string readString() {
+      uint32_t size = read<uint32_t>();
+      const char *p = take(size);
+      return p ? std::string(p, size) : std::string();
+    }
+  };
+
+  enum AllocSiteKind { NoSite, GlobalSite, InstructionSite };
+
+  enum ObjectFlags {
+    IsLocal = 1,
+    IsGlobal = 2,
+    IsFixed = 4,
+    IsUserSpecified = 8,
+    IsReadOnly = 16
+  };
+
+  struct SnapshotObject {
+    uint64_t address;
+    uint32_t size;
+    uint8_t flags;
+    std::string name;
+    const Value *allocSite;
+    const char *bytes;
+  };
+
+  struct SnapshotCell {
+    Expr::Width width;
+    const char *words;
+  };
+
+  /// Maps the host addresses of a previous run to those of this one.
+  class SnapshotRelocator {
+    std::map<uint64_t, uint64_t> functions;
+    /// [old end] -> <old start, new start>
+    std::map<uint64_t, std::pair<uint64_t, uint64_t> > ranges;
+
+  public:
+    void addFunction(uint64_t from, uint64_t to) { functions[from] = to; }
+    void addRange(uint64_t from, uint64_t size, uint64_t to) {
+      if (size)
+        ranges[from + size] = std::make_pair(from, to);
+    }
+
+    uint64_t relocate(uint64_t value) const {
+      std::map<uint64_t, uint64_t>::const_iterator fit = functions.find(value);
+      if (fit != functions.end())
+        return fit->second;
+      std::map<uint64_t, std::pair<uint64_t, uint64_t> >::const_iterator
+        rit = ranges.upper_bound(value);
+      if (rit != ranges.end() && value >= rit->second.first)
+        return rit->second.second + (value - rit->second.first);
+      return value;
+    }
+
+    /// Relocates the pointer-aligned words of an object at address.
+    void relocate(uint64_t address, std::vector<uint8_t> &bytes) const {
+      for (size_t i = (8 - address % 8) % 8; i + 8 <= bytes.size(); i += 8) {
+        uint64_t value;
+        memcpy(&value, &bytes[i], sizeof(value));
+        value = relocate(value);
+        memcpy(&bytes[i], &value, sizeof(value));
+      }
+    }
+  };
+
+  struct SnapshotFrame {
+    KFunction *kf;
+    unsigned caller;
+    std::vector<uint64_t> allocas;
+    uint64_t varargs;
+    std::vector<SnapshotCell> locals;
+  };
+}
+
+void Executor::setupInitSnapshot(int argc, char **argv, char **envp) {
+  initSnapshotPath.clear();
+  initSnapshotPending = false;
+  if (InitSnapshotDir.empty())
+    return;
+  if (!memory->isDeterministic()) {
+    klee_warning("--init-snapshot-dir requires --allocate-determ, ignoring");
+    return;
+  }
+  if (usingSeeds || replayKTest || replayPath) {
+    klee_warning("init snapshots are not used when seeding or replaying");
+    return;
+  }
+
+  std::string bitcode;
+  {
+    raw_string_ostream os(bitcode);
+    WriteBitcodeToFile(kmodule->module, os);
+  }
+  uint64_t hash = hashBytes(0xcbf29ce484222325ULL, bitcode.data(),
+                            bitcode.size());
+  for (int i = 0; i < argc; i++)
+    hash = hashString(hash, argv[i]);
+  hash = hashString(hash, "");
+  for (int i = 0; envp[i]; i++)
+    hash = hashString(hash, envp[i]);
+  // Objects are restored at their addresses, so the space must be the same.
+  uint64_t space[2] = { memory->getDeterministicStart(),
+                        memory->getDeterministicSpaceSize() };
+  hash = hashBytes(hash, (const char *) space, sizeof(space));
+
+  std::string name;
+  raw_string_ostream os(name);
+  os << InitSnapshotDir << "/init-";
+  os.write_hex(hash);
+  os << ".snapshot";
+  initSnapshotPath = os.str();
+  initSnapshotPending = true;
+}
+
+void Executor::saveInitSnapshot(ExecutionState &state) {
+  if (!initSnapshotPending)
+    return;
+  initSnapshotPending = false;
+
+  // Only a lone, fully concrete state is known to be where every run
+  // reaches the loop.
+  if (states.size() != 1 || !addedStates.empty() ||
+      !state.constraints.empty() || !state.symbolics.empty() ||
+      (state.cacheModel && state.cacheModel->isEnabled())) {
+    klee_warning("initialization is not concrete, not saving a snapshot");
+    return;
+  }
+
+  std::string data;
+  raw_string_ostream os(data);
+  SnapshotWriter out(os);
+  os.write(snapshotMagic, sizeof(snapshotMagic));
+  out.write<uint64_t>(memory->getUsedDeterministicSize());
+
+  // Host addresses that may be stored in memory or registers.
+  std::vector<Function *> functions;
+  for (Module::iterator it = kmodule->module->begin(),
+         ie = kmodule->module->end(); it != ie; ++it) {
+    Function *f = it;
+    if (legalFunctions.count(globalAddresses[f]->getZExtValue()))
+      functions.push_back(f);
+  }
+  out.write<uint32_t>(functions.size());
+  for (unsigned i = 0; i < functions.size(); i++) {
+    out.write(functions[i]->getName().str());
+    out.write<uint64_t>(globalAddresses[functions[i]]->getZExtValue());
+  }
+  out.write<uint32_t>(externalObjects.size());
+  for (unsigned i = 0; i < externalObjects.size(); i++) {
+    out.write<uint64_t>(externalObjects[i]->address);
+    out.write<uint32_t>(externalObjects[i]->size);
+  }
+
+  out.write<uint32_t>(state.addressSpace.objects.size());
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+         ie = state.addressSpace.objects.end(); it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *obj = it->second;
+    out.write<uint64_t>(mo->address);
+    out.write<uint32_t>(mo->size);
+    out.write<uint8_t>((mo->isLocal ? IsLocal : 0) |
+                       (mo->isGlobal ? IsGlobal : 0) |
+                       (mo->isFixed ? IsFixed : 0) |
+                       (mo->isUserSpecified ? IsUserSpecified : 0) |
+                       (obj->readOnly ? IsReadOnly : 0));
+    out.write(mo->name);
+
+    const Instruction *inst = dyn_cast_or_null<Instruction>(mo->allocSite);
+    Function *f =
+      inst ? const_cast<Function *>(inst->getParent()->getParent()) : 0;
+    if (const GlobalValue *gv = dyn_cast_or_null<GlobalValue>(mo->allocSite)) {
+      out.write<uint8_t>(GlobalSite);
+      out.write(gv->getName().str());
+    } else if (f && kmodule->functionMap.count(f)) {
+      KFunction *kf = kmodule->functionMap[f];
+      unsigned index = 0;
+      while (index < kf->numInstructions &&
+             kf->instructions[index]->inst != inst)
+        index++;
+      out.write<uint8_t>(InstructionSite);
+      out.write(f->getName().str());
+      out.write<uint32_t>(index);
+    } else {
+      out.write<uint8_t>(NoSite);
+    }
+
+    for (unsigned i = 0; i < mo->size; i++) {
+      uint64_t byte;
+      if (!obj->readConcrete(i, Expr::Int8, byte)) {
+        klee_warning("initialization left symbolic memory, not saving a "
+                     "snapshot");
+        return;
+      }
+      out.write<uint8_t>(byte);
+    }
+  }
+
+  out.write<uint32_t>(state.stack.size());
+  for (unsigned i = 0; i < state.stack.size(); i++) {
+    const StackFrame &sf = state.stack[i];
+    out.write(sf.kf->function->getName().str());
+    out.write<uint32_t>(i ? getInstructionIndex(state.stack[i - 1].kf,
+                                                sf.caller)
+                          : ~0u);
+    out.write<uint32_t>(sf.allocas.size());
+    for (unsigned j = 0; j < sf.allocas.size(); j++)
+      out.write<uint64_t>(sf.allocas[j]->address);
+    out.write<uint64_t>(sf.varargs ? sf.varargs->address : 0);
+
+    out.write<uint32_t>(sf.kf->numRegisters);
+    for (unsigned j = 0; j < sf.kf->numRegisters; j++) {
+      const Cell &cell = sf.locals[j];
+      if (cell.isImmediate()) {
+        out.write<uint32_t>(cell.getWidth());
+        out.write<uint64_t>(cell.getImmediate());
+        continue;
+      }
+      const ref<Expr> &value = cell.getValue();
+      if (value.isNull()) {
+        out.write<uint32_t>(0);
+        continue;
+      }
+      ConstantExpr *ce = dyn_cast<ConstantExpr>(value);
+      if (!ce) {
+        klee_warning("initialization left symbolic registers, not saving a "
+                     "snapshot");
+        return;
+      }
+      const APInt &v = ce->getAPValue();
+      out.write<uint32_t>(ce->getWidth());
+      for (unsigned k = 0; k < v.getNumWords(); k++)
+        out.write<uint64_t>(v.getRawData()[k]);
+    }
+  }
+
+  // Resume by executing the castan_loop() call again.
+  out.write<uint32_t>(getInstructionIndex(state.stack.back().kf,
+                                          state.prevPC));
+  out.write<uint32_t>(state.incomingBBIndex);
+  os.flush();
+
+  // Write to a temporary file of our own so that concurrent runs never see
+  // a partial snapshot, nor write into the same one.
+  std::string tmpPath = initSnapshotPath + ".XXXXXX";
+  std::vector<char> tmpName(tmpPath.begin(), tmpPath.end());
+  tmpName.push_back(0);
+  int fd = mkstemp(&tmpName[0]);
+  if (fd == -1) {
+    klee_warning("error opening %s: %s", tmpPath.c_str(), strerror(errno));
+    return;
+  }
+  tmpPath = &tmpName[0];
+  {
+    raw_fd_ostream f(fd, true);
+    f << data;
+    f.close();
+    if (f.has_error()) {
+      f.clear_error();
+      klee_warning("error writing %s", tmpPath.c_str());
+      unlink(tmpPath.c_str());
+      return;
+    }
+  }
+
+  if (error_code ec = sys::fs::rename(tmpPath, initSnapshotPath)) {
+    klee_warning("error writing %s: %s", initSnapshotPath.c_str(),
+                 ec.message().c_str());
+    unlink(tmpPath.c_str());
+    return;
+  }
+  klee_message("saved init snapshot to %s (%lu bytes)",
+               initSnapshotPath.c_str(), (unsigned long) data.size());
+}
+
+bool Executor::restoreInitSnapshot(ExecutionState &state) {
+  if (initSnapshotPath.empty())
+    return false;
+
+  OwningPtr<MemoryBuffer> buffer;
+  if (MemoryBuffer::getFile(initSnapshotPath, buffer))
+    return false;
+  SnapshotReader in(buffer->getBufferStart(), buffer->getBufferEnd());
+
+  const char *magic = in.take(sizeof(snapshotMagic));
+  if (!magic || memcmp(magic, snapshotMagic, sizeof(snapshotMagic))) {
+    klee_warning("%s is not an init snapshot, ignoring",
+                 initSnapshotPath.c_str());
+    return false;
+  }
+
+  // Parse and validate everything before touching the state.
+  uint64_t usedDeterministicSize = in.read<uint64_t>();
+
+  SnapshotRelocator relocator;
+  bool relocatable = true;
+  unsigned numFunctions = in.read<uint32_t>();
+  for (unsigned i = 0; in.ok && i < numFunctions; i++) {
+    Function *f = kmodule->module->getFunction(in.readString());
+    uint64_t address = in.read<uint64_t>();
+    if (f && globalAddresses.count(f))
+      relocator.addFunction(address, globalAddresses[f]->getZExtValue());
+    else
+      relocatable = false;
+  }
+  // [old address] -> index in externalObjects
+  std::map<uint64_t, unsigned> externalIndex;
+  unsigned numExternalObjects = in.read<uint32_t>();
+  if (numExternalObjects != externalObjects.size())
+    relocatable = false;
+  for (unsigned i = 0; in.ok && relocatable && i < numExternalObjects; i++) {
+    uint64_t address = in.read<uint64_t>();
+    uint32_t size = in.read<uint32_t>();
+    if (size != externalObjects[i]->size)
+      relocatable = false;
+    relocator.addRange(address, size, externalObjects[i]->address);
+    externalIndex[address] = i;
+  }
+  if (in.ok && !relocatable) {
+    klee_warning("%s does not match this module, ignoring",
+                 initSnapshotPath.c_str());
+    return false;
+  }
+
+  std::vector<SnapshotObject> objects(in.read<uint32_t>());
+  for (unsigned i = 0; in.ok && i < objects.size(); i++) {
+    SnapshotObject &o = objects[i];
+    o.address = in.read<uint64_t>();
+    o.size = in.read<uint32_t>();
+    o.flags = in.read<uint8_t>();
+    o.name = in.readString();
+    o.allocSite = 0;
+    switch (in.read<uint8_t>()) {
+    case GlobalSite:
+      o.allocSite = kmodule->module->getNamedValue(in.readString());
+      break;
+    case InstructionSite: {
+      Function *f = kmodule->module->getFunction(in.readString());
+      unsigned index = in.read<uint32_t>();
+      if (f && kmodule->functionMap.count(f)) {
+        KFunction *kf = kmodule->functionMap[f];
+        if (index < kf->numInstructions)
+          o.allocSite = kf->instructions[index]->inst;
+      }
+      break;
+    }
+    default:
+      break;
+    }
+    o.bytes = in.take(o.size);
+  }
+  bool fits = usedDeterministicSize <= memory->getDeterministicSpaceSize();
+  for (unsigned i = 0; in.ok && fits && i < objects.size(); i++) {
+    const SnapshotObject &o = objects[i];
+    if (!externalIndex.count(o.address) && !(o.flags & IsFixed) &&
+        !memory->isInDeterministicSpace(o.address, o.size))
+      fits = false;
+  }
+  if (in.ok && !fits) {
+    klee_warning("%s does not fit the deterministic allocation space, "
+                 "ignoring", initSnapshotPath.c_str());
+    return false;
+  }
+
+  std::vector<SnapshotFrame> frames(in.read<uint32_t>());
+  for (unsigned i = 0; in.ok && i < frames.size(); i++) {
+    SnapshotFrame &sf = frames[i];
+    Function *f = kmodule->module->getFunction(in.readString());
+    sf.kf = f && kmodule->functionMap.count(f) ? kmodule->functionMap[f] : 0;
+    sf.caller = in.read<uint32_t>();
+    sf.allocas.resize(in.read<uint32_t>());
+    for (unsigned j = 0; in.ok && j < sf.allocas.size(); j++)
+      sf.allocas[j] = in.read<uint64_t>();
+    sf.varargs = in.read<uint64_t>();
+    sf.locals.resize(in.read<uint32_t>());
+    for (unsigned j = 0; in.ok && j < sf.locals.size(); j++) {
+      sf.locals[j].width = in.read<uint32_t>();
+      sf.locals[j].words = in.take((sf.locals[j].width + 63) / 64 * 8);
+    }
+
+    if (!sf.kf || sf.locals.size() != sf.kf->numRegisters ||
+        (i ? sf.caller >= frames[i - 1].kf->numInstructions
+           : sf.caller != ~0u))
+      in.ok = false;
+  }
+  unsigned pc = in.read<uint32_t>();
+  unsigned incomingBBIndex = in.read<uint32_t>();
+
+  if (!in.ok || frames.empty() || pc >= frames.back().kf->numInstructions) {
+    klee_warning("%s does not match this module, ignoring",
+                 initSnapshotPath.c_str());
+    return false;
+  }
+
+  // Objects, reusing the globals and arguments that were just set up.
+  memory->setUsedDeterministicSize(usedDeterministicSize);
+
+  // Match the snapshot objects with the ones that were just set up: the
+  // external objects by creation order, the others by address and size.
+  std::map<uint64_t, const MemoryObject *> existing, restored;
+  for (MemoryMap::iterator it = state.addressSpace.objects.begin(),
+         ie = state.addressSpace.objects.end(); it != ie; ++it)
+    existing[it->first->address] = it->first;
+
+  std::vector<const MemoryObject *> matches(objects.size());
+  for (unsigned i = 0; i < objects.size(); i++) {
+    const SnapshotObject &o = objects[i];
+    std::map<uint64_t, unsigned>::iterator ext = externalIndex.find(o.address);
+    if (ext != externalIndex.end()) {
+      matches[i] = externalObjects[ext->second];
+    } else {
+      std::map<uint64_t, const MemoryObject *>::iterator it =
+        existing.find(o.address);
+      if (it != existing.end() && it->second->size == o.size)
+        matches[i] = it->second;
+    }
+    if (matches[i])
+      existing.erase(matches[i]->address);
+  }
+
+  // The address space is keyed by address, so stale objects must go before
+  // restored ones take their place.
+  for (std::map<uint64_t, const MemoryObject *>::iterator
+         it = existing.begin(), ie = existing.end(); it != ie; ++it)
+    state.addressSpace.unbindObject(it->second);
+
+  for (unsigned i = 0; i < objects.size(); i++) {
+    const SnapshotObject &o = objects[i];
+    const MemoryObject *mo = matches[i];
+    ObjectState *os;
+
+    if (mo) {
+      restored[o.address] = mo;
+      // Read-only external objects hold this host's tables.
+      if (externalIndex.count(o.address) && (o.flags & IsReadOnly))
+        continue;
+      os = state.addressSpace.getWriteable(mo,
+                                           state.addressSpace.findObject(mo));
+    } else {
+      MemoryObject *newObject =
+        (o.flags & IsFixed)
+          ? memory->allocateFixed(o.address, o.size, o.allocSite)
+          : memory->allocateAt(o.address, o.size, o.flags & IsLocal,
+                               o.flags & IsGlobal, o.allocSite);
+      assert(newObject && "object outside the deterministic space");
+      newObject->isGlobal = o.flags & IsGlobal;
+      newObject->isUserSpecified = o.flags & IsUserSpecified;
+      newObject->setName(o.name);
+      mo = newObject;
+      os = bindObjectInState(state, mo, false);
+    }
+
+    std::vector<uint8_t> bytes(o.bytes, o.bytes + o.size);
+    relocator.relocate(o.address, bytes);
+    for (unsigned j = 0; j < o.size; j++)
+      os->write8(j, bytes[j]);
+    os->setReadOnly(o.flags & IsReadOnly);
+    restored[o.address] = mo;
+  }
+
+  // Stack.
+  while (!state.stack.empty())
+    state.popFrame();
+
+  for (unsigned i = 0; i < frames.size(); i++) {
+    const SnapshotFrame &f = frames[i];
+    state.pushFrame(i ? KInstIterator(&frames[i - 1].kf->instructions[f.caller])
+                      : KInstIterator(),
+                    f.kf);
+    StackFrame &sf = state.stack.back();
+    for (unsigned j = 0; j < f.allocas.size(); j++)
+      if (restored.count(f.allocas[j]))
+        sf.allocas.push_back(restored[f.allocas[j]]);
+    if (f.varargs && restored.count(f.varargs))
+      sf.varargs = const_cast<MemoryObject *>(restored[f.varargs]);
+
+    for (unsigned j = 0; j < f.locals.size(); j++) {
+      const SnapshotCell &c = f.locals[j];
+      if (c.width == 0)
+        continue;
+      if (c.width <= 64) {
+        uint64_t value;
+        memcpy(&value, c.words, sizeof(value));
+        if (c.width == Expr::Int64)
+          value = relocator.relocate(value);
+        sf.locals[j].setImmediate(value, c.width);
+      } else {
+        std::vector<uint64_t> words((c.width + 63) / 64);
+        memcpy(&words[0], c.words, words.size() * sizeof(uint64_t));
+        sf.locals[j].setValue(ConstantExpr::alloc(APInt(c.width, words)));
+      }
+    }
+
+    if (statsTracker)
+      statsTracker->framePushed(state, i ? &state.stack[i - 1] : 0);
+  }
+
+  state.pc = KInstIterator(&frames.back().kf->instructions[pc]);
+  state.prevPC = state.pc;
+  state.incomingBBIndex = incomingBBIndex;
+
+  // This run has nothing left to save.
+  initSnapshotPending = false;
+  return true;
+}
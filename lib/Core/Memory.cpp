@@ -10,6 +10,7 @@
 #include "Memory.h"
 
 #include "Context.h"
+#include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 #include "klee/util/BitArray.h"
@@ -32,7 +33,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
+#include <set>
 #include <sstream>
 
 using namespace llvm;
@@ -102,11 +105,12 @@ ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(mo->size),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    numUpdatesAtCompaction(0),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
@@ -116,7 +120,6 @@ ObjectState::ObjectState(const MemoryObject *mo)
         getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), size);
     updates = UpdateList(array, 0);
   }
-  memset(concreteStore, 0, size);
 }
 
 
@@ -124,47 +127,52 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(mo->size),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    numUpdatesAtCompaction(0),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
   makeSymbolic();
-  memset(concreteStore, 0, size);
 }
 
 ObjectState::ObjectState(const ObjectState &os) 
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
+    concreteStore(os.concreteStore),
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
-    knownSymbolics(0),
+    knownSymbolics(os.knownSymbolics
+                     ? new PagedArray<ref<Expr>, 512>(*os.knownSymbolics)
+                     : 0),
     updates(os.updates),
+    numUpdatesAtCompaction(os.numUpdatesAtCompaction),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
   if (object)
     object->refCount++;
+}
 
-  if (os.knownSymbolics) {
-    knownSymbolics = new ref<Expr>[size];
-    for (unsigned i=0; i<size; i++)
-      knownSymbolics[i] = os.knownSymbolics[i];
-  }
-
-  memcpy(concreteStore, os.concreteStore, size*sizeof(*concreteStore));
+size_t ObjectState::getCopySize() const {
+  size_t bytes = concreteStore.getCopySize();
+  if (concreteMask)
+    bytes += concreteMask->getCopySize();
+  if (flushMask)
+    bytes += flushMask->getCopySize();
+  if (knownSymbolics)
+    bytes += knownSymbolics->getCopySize();
+  return bytes;
 }
 
 ObjectState::~ObjectState() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
-  delete[] concreteStore;
+  if (knownSymbolics) delete knownSymbolics;
 
   if (object)
   {
@@ -235,10 +243,70 @@ const UpdateList &ObjectState::getUpdates() const {
   return updates;
 }
 
+bool ObjectState::compactUpdates(const ConstraintManager &constraints,
+                                 UpdateList &result) const {
+  const UpdateList &ul = getUpdates();
+  numUpdatesAtCompaction = getNumUpdates();
+
+  // Collect the live writes, newest first: an older write to an identical
+  // index can never be read.
+  std::vector< std::pair< ref<Expr>, ref<Expr> > > Writes;
+  std::set< ref<Expr> > Written;
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    ref<Expr> index = constraints.simplifyExpr(un->index);
+    if (Written.insert(index).second)
+      Writes.push_back(std::make_pair(index,
+                                      constraints.simplifyExpr(un->value)));
+  }
+  std::reverse(Writes.begin(), Writes.end());
+
+  // Fold the concrete writes that precede every symbolic one into a new
+  // root, as in getUpdates.
+  const Array *root = ul.root;
+  unsigned Begin = 0, End = Writes.size();
+  if (root->isConstantArray()) {
+    std::vector< ref<ConstantExpr> > Contents(root->constantValues);
+    for (; Begin != End; ++Begin) {
+      ConstantExpr *Index = dyn_cast<ConstantExpr>(Writes[Begin].first);
+      if (!Index || Index->getZExtValue() >= size)
+        break;
+
+      ConstantExpr *Value = dyn_cast<ConstantExpr>(Writes[Begin].second);
+      if (!Value)
+        break;
+
+      Contents[Index->getZExtValue()] = Value;
+    }
+
+    if (Begin) {
+      static unsigned id = 0;
+      root = getArrayCache()->CreateArray(
+          "compacted_arr" + llvm::utostr(++id), size, &Contents[0],
+          &Contents[0] + Contents.size());
+    }
+  }
+
+  // Keep the nodes, which sibling states and the query caches share, unless
+  // some can be dropped.
+  if (!Begin && End == ul.getSize())
+    return false;
+
+  UpdateList compacted(root, 0);
+  for (; Begin != End; ++Begin)
+    compacted.extend(Writes[Begin].first, Writes[Begin].second);
+  result = compacted;
+  return true;
+}
+
+void ObjectState::setCompactedUpdates(const UpdateList &compacted) {
+  updates = compacted;
+  numUpdatesAtCompaction = getNumUpdates();
+}
+
 void ObjectState::makeConcrete() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
-  if (knownSymbolics) delete[] knownSymbolics;
+  if (knownSymbolics) delete knownSymbolics;
   concreteMask = 0;
   flushMask = 0;
   knownSymbolics = 0;
@@ -258,15 +326,13 @@ void ObjectState::makeSymbolic() {
 
 void ObjectState::initializeToZero() {
   makeConcrete();
-  memset(concreteStore, 0, size);
+  concreteStore.fill(0);
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
-  for (unsigned i=0; i<size; i++) {
-    // randomly selected by 256 sided die
-    concreteStore[i] = 0xAB;
-  }
+  // randomly selected by 256 sided die
+  concreteStore.fill(0xAB);
 }
 
 /*
@@ -296,7 +362,7 @@ void ObjectState::flushRangeForRead(unsigned rangeBase,
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
+                       (*knownSymbolics)[offset]);
       }
 
       flushMask->unset(offset);
@@ -317,7 +383,7 @@ void ObjectState::flushRangeForWrite(unsigned rangeBase,
       } else {
         assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
         updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
+                       (*knownSymbolics)[offset]);
         setKnownSymbolic(offset, 0);
       }
 
@@ -343,7 +409,7 @@ bool ObjectState::isByteFlushed(unsigned offset) const {
 }
 
 bool ObjectState::isByteKnownSymbolic(unsigned offset) const {
-  return knownSymbolics && knownSymbolics[offset].get();
+  return knownSymbolics && (*knownSymbolics)[offset].get();
 }
 
 void ObjectState::markByteConcrete(unsigned offset) {
@@ -373,11 +439,14 @@ void ObjectState::markByteFlushed(unsigned offset) {
 void ObjectState::setKnownSymbolic(unsigned offset, 
                                    Expr *value /* can be null */) {
   if (knownSymbolics) {
-    knownSymbolics[offset] = value;
+    if (value)
+      knownSymbolics->set(offset, value);
+    else if ((*knownSymbolics)[offset].get())
+      knownSymbolics->reset(offset);
   } else {
     if (value) {
-      knownSymbolics = new ref<Expr>[size];
-      knownSymbolics[offset] = value;
+      knownSymbolics = new PagedArray<ref<Expr>, 512>(size);
+      knownSymbolics->set(offset, value);
     }
   }
 }
@@ -388,7 +457,7 @@ ref<Expr> ObjectState::read8(unsigned offset) const {
   if (isByteConcrete(offset)) {
     return ConstantExpr::create(concreteStore[offset], Expr::Int8);
   } else if (isByteKnownSymbolic(offset)) {
-    return knownSymbolics[offset];
+    return (*knownSymbolics)[offset];
   } else {
     assert(isByteFlushed(offset) && "unflushed byte without cache value");
     
@@ -416,7 +485,7 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
-  concreteStore[offset] = value;
+  concreteStore.set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -499,6 +568,24 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   return Res;
 }
 
+bool ObjectState::readConcrete(unsigned offset, Expr::Width width,
+                               uint64_t &value) const {
+  assert(width <= 64 && "Invalid width for concrete read!");
+  unsigned NumBytes = Expr::getMinBytesForWidth(width);
+  value = 0;
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+    if (!isByteConcrete(offset + idx))
+      return false;
+    value |= (uint64_t) concreteStore[offset + idx] << (8 * i);
+  }
+
+  // Treat bool specially, it is the only non-byte sized write we allow.
+  if (width == Expr::Bool)
+    value &= 1;
+  return true;
+}
+
 void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
   // Truncate offset to 32-bits.
   offset = ZExtExpr::create(offset, Expr::Int32);
@@ -12,6 +12,7 @@
 
 #include "Context.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/PagedArray.h"
 
 #include "llvm/ADT/StringExtras.h"
 
@@ -25,6 +26,7 @@ namespace llvm {
 namespace klee {
 
 class BitArray;
+class ConstraintManager;
 class MemoryManager;
 class Solver;
 class ArrayCache;
@@ -156,18 +158,27 @@ private:
 
   const MemoryObject *object;
 
-  uint8_t *concreteStore;
+  // Pages of the store, masks and known symbolics are shared between
+  // copies until written, and only allocated once they differ from their
+  // initial value, so a large, mostly concrete object pays for its symbolic
+  // bytes page by page.
+  PagedArray<uint8_t> concreteStore;
   // XXX cleanup name of flushMask (its backwards or something)
   BitArray *concreteMask;
 
   // mutable because may need flushed during read of const
   mutable BitArray *flushMask;
 
-  ref<Expr> *knownSymbolics;
+  PagedArray<ref<Expr>, 512> *knownSymbolics;
 
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  // Length of the update list when compaction was last attempted, so that
+  // it is only retried once the list has grown again. mutable as it is a
+  // hint shared by all the states holding this object.
+  mutable unsigned numUpdatesAtCompaction;
+
 public:
   unsigned size;
 
@@ -199,6 +210,11 @@ public:
   ref<Expr> read(unsigned offset, Expr::Width width) const;
   ref<Expr> read8(unsigned offset) const;
 
+  /// Read width bits at offset without building an expression.
+  /// \return false if any of the bytes is symbolic.
+  bool readConcrete(unsigned offset, Expr::Width width,
+                    uint64_t &value) const;
+
   // return bytes written.
   void write(unsigned offset, ref<Expr> value);
   void write(ref<Expr> offset, ref<Expr> value);
@@ -208,6 +224,33 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Number of bytes the copy constructor duplicates. Pages of large objects
+  /// are shared rather than copied, so this is their page tables.
+  size_t getCopySize() const;
+
+  /// Number of writes in the update list.
+  unsigned getNumUpdates() const {
+    return updates.head ? updates.head->getSize() : 0;
+  }
+
+  /// Whether the update list grew by more than threshold writes since
+  /// compaction was last attempted.
+  bool shouldCompactUpdates(unsigned threshold) const {
+    return getNumUpdates() > numUpdatesAtCompaction + threshold;
+  }
+
+  /// Compute a shorter update list with the same meaning under the given
+  /// constraints: simplify indices and values, drop writes overwritten by a
+  /// later write to an identical index, and fold the leading constant writes
+  /// into a new constant array.
+  /// \return false, leaving result alone, if no write can be dropped.
+  bool compactUpdates(const ConstraintManager &constraints,
+                      UpdateList &result) const;
+
+  /// Replace the update list by a compacted one. The object must not be
+  /// shared with states that have other constraints.
+  void setCompactedUpdates(const UpdateList &compacted);
+
 private:
   const UpdateList &getUpdates() const;
 
@@ -165,6 +165,20 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t address, uint64_t size,
   return res;
 }
 
+MemoryObject *MemoryManager::allocateAt(uint64_t address, uint64_t size,
+                                        bool isLocal, bool isGlobal,
+                                        const llvm::Value *allocSite) {
+  assert(DeterministicAllocation && "non-deterministic addresses");
+  if (!isInDeterministicSpace(address, size))
+    return 0;
+
+  ++stats::allocations;
+  MemoryObject *res = new MemoryObject(address, size, isLocal, isGlobal, false,
+                                       allocSite, this);
+  objects.insert(res);
+  return res;
+}
+
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
@@ -178,3 +192,18 @@ void MemoryManager::markFreed(MemoryObject *mo) {
 size_t MemoryManager::getUsedDeterministicSize() {
   return nextFreeSlot - deterministicSpace;
 }
+
+void MemoryManager::setUsedDeterministicSize(size_t size) {
+  assert(DeterministicAllocation && size <= spaceSize);
+  nextFreeSlot = deterministicSpace + size;
+}
+
+bool MemoryManager::isDeterministic() const { return DeterministicAllocation; }
+
+bool MemoryManager::isInDeterministicSpace(uint64_t address,
+                                           uint64_t size) const {
+  uint64_t start = (uint64_t)deterministicSpace;
+  size = std::max(size, (uint64_t)1);
+  return address >= start && size <= spaceSize &&
+         address - start <= spaceSize - size;
+}
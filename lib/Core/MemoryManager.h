@@ -43,6 +43,12 @@ public:
                          const llvm::Value *allocSite, size_t alignment = 8);
   MemoryObject *allocateFixed(uint64_t address, uint64_t size,
                               const llvm::Value *allocSite);
+  /**
+   * Recreates an object at an address previously handed out by
+   * deterministic allocation, e.g. when restoring a snapshot.
+   */
+  MemoryObject *allocateAt(uint64_t address, uint64_t size, bool isLocal,
+                           bool isGlobal, const llvm::Value *allocSite);
   void deallocate(const MemoryObject *mo);
   void markFreed(MemoryObject *mo);
   ArrayCache *getArrayCache() const { return arrayCache; }
@@ -51,6 +57,12 @@ public:
    * Returns the size used by deterministic allocation in bytes
    */
   size_t getUsedDeterministicSize();
+  void setUsedDeterministicSize(size_t size);
+  bool isDeterministic() const;
+  uint64_t getDeterministicStart() const { return (uint64_t)deterministicSpace; }
+  size_t getDeterministicSpaceSize() const { return spaceSize; }
+  /// Whether [address, address + size) lies within the deterministic space.
+  bool isInDeterministicSpace(uint64_t address, uint64_t size) const;
 };
 
 } // End klee namespace
@@ -0,0 +1,255 @@
+//===-- MetricsTracker.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MetricsTracker.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Statistics.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/SpillArena.h"
+#include "klee/Internal/System/Time.h"
+#include "castan/Internal/CacheModel.h"
+
+#include "CoreStats.h"
+#include "Executor.h"
+#include "MemoryManager.h"
+#include "QueryProfiler.h"
+#include "TimingSolver.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<bool>
+  OutputMetrics("output-metrics",
+                cl::init(false),
+                cl::desc("Write periodic metrics as JSON lines to run.metrics (default=off)"));
+
+  cl::opt<std::string>
+  MetricsSocket("metrics-socket",
+                cl::desc("Serve periodic metrics as JSON lines to the clients "
+                         "of a Unix socket at this path (default=off)"));
+
+  cl::opt<double>
+  MetricsWriteInterval("metrics-write-interval",
+                       cl::init(1.),
+                       cl::desc("Approximate number of seconds between metrics writes (default=1.0s)"));
+}
+
+///
+
+bool MetricsTracker::useMetrics() {
+  return OutputMetrics || !MetricsSocket.empty();
+}
+
+namespace klee {
+  class WriteMetricsTimer : public Executor::Timer {
+    MetricsTracker *metricsTracker;
+
+  public:
+    WriteMetricsTimer(MetricsTracker *_metricsTracker)
+      : metricsTracker(_metricsTracker) {}
+    ~WriteMetricsTimer() {}
+
+    void run() { metricsTracker->writeMetricsLine(); }
+  };
+}
+
+MetricsTracker::MetricsTracker(Executor &_executor)
+  : executor(_executor),
+    metricsFile(0),
+    listenSocket(-1),
+    startWallTime(util::getWallTime()),
+    lastWallTime(startWallTime),
+    lastInstructions(0) {
+  if (OutputMetrics) {
+    metricsFile = executor.interpreterHandler->openOutputFile("run.metrics");
+    assert(metricsFile && "unable to open metrics file");
+  }
+
+  if (!MetricsSocket.empty())
+    openSocket(MetricsSocket);
+
+  if (MetricsWriteInterval > 0)
+    executor.addTimer(new WriteMetricsTimer(this), MetricsWriteInterval);
+}
+
+MetricsTracker::~MetricsTracker() {
+  delete metricsFile;
+  for (unsigned i = 0; i < clients.size(); i++)
+    close(clients[i]);
+  if (listenSocket != -1) {
+    close(listenSocket);
+    unlink(MetricsSocket.c_str());
+  }
+}
+
+void MetricsTracker::openSocket(const std::string &path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    klee_error("metrics socket path too long: %s", path.c_str());
+  strcpy(addr.sun_path, path.c_str());
+
+  listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenSocket == -1)
+    klee_error("unable to create metrics socket: %s", strerror(errno));
+  // The interpreter must never wait for a client.
+  fcntl(listenSocket, F_SETFL, O_NONBLOCK);
+
+  unlink(path.c_str());
+  if (bind(listenSocket, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+      listen(listenSocket, 4) == -1)
+    klee_error("unable to listen on metrics socket %s: %s", path.c_str(),
+               strerror(errno));
+}
+
+void MetricsTracker::acceptClients() {
+  int client;
+  while ((client = accept(listenSocket, 0, 0)) != -1) {
+    fcntl(client, F_SETFL, O_NONBLOCK);
+    clients.push_back(client);
+  }
+}
+
+/// Writes the non-empty buckets of a log2 histogram as an object mapping i to
+/// the count of values less than 2^i.
+static void writeHistogram(raw_ostream &os, const uint64_t *histogram,
+                           unsigned size) {
+  os << "{";
+  bool first = true;
+  for (unsigned i = 0; i < size; i++) {
+    if (!histogram[i])
+      continue;
+    if (!first)
+      os << ",";
+    os << "\"" << i << "\":" << histogram[i];
+    first = false;
+  }
+  os << "}";
+}
+
+static void writeString(raw_ostream &os, const std::string &s) {
+  os << '"';
+  for (unsigned i = 0; i < s.size(); i++) {
+    if (s[i] == '"' || s[i] == '\\')
+      os << '\\';
+    os << s[i];
+  }
+  os << '"';
+}
+
+void MetricsTracker::writeMetricsLine() {
+  double now = util::getWallTime();
+  uint64_t instructions = stats::instructions;
+  double instructionsPerSecond =
+      now > lastWallTime ? (instructions - lastInstructions) /
+                               (now - lastWallTime) : 0.;
+  lastWallTime = now;
+  lastInstructions = instructions;
+
+  // [loop iterations] -> number of states
+  std::map<int, uint64_t> iterations;
+  for (std::set<ExecutionState *>::iterator it = executor.states.begin(),
+                                            ie = executor.states.end();
+       it != ie; ++it) {
+    castan::CacheModel *cacheModel = (*it)->cacheModel;
+    iterations[cacheModel ? cacheModel->getNumIterations() : 0]++;
+  }
+
+  std::string line;
+  raw_string_ostream os(line);
+  os << "{\"time\":" << now - startWallTime
+     << ",\"instructions\":" << instructions
+     << ",\"instructionsPerSecond\":" << instructionsPerSecond
+     << ",\"states\":" << executor.states.size()
+     << ",\"forks\":" << stats::forks
+     << ",\"queries\":" << stats::queries
+     << ",\"solverTime\":" << stats::solverTime / 1000000.
+     << ",\"cacheAccesses\":" << stats::cacheAccesses
+     << ",\"cacheMisses\":" << stats::cacheMisses
+     << ",\"cloneBytes\":" << stats::cloneBytes
+     << ",\"mallocUsage\":"
+     << util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize() +
+            util::GetSpillArenaResidentUsage()
+     << ",\"spillUsage\":" << util::GetSpillArenaUsage();
+
+  QueryProfiler *profiler = executor.solver->profiler;
+  os << ",\"solverCalls\":{";
+  if (profiler) {
+    const std::map<std::string, uint64_t> &origins = profiler->getOrigins();
+    for (std::map<std::string, uint64_t>::const_iterator
+             it = origins.begin(), ie = origins.end(); it != ie; ++it) {
+      if (it != origins.begin())
+        os << ",";
+      writeString(os, it->first);
+      os << ":" << it->second;
+    }
+  }
+  os << "}";
+
+  os << ",\"solverTimeHistogram\":";
+  if (profiler) {
+    const std::vector<uint64_t> &histogram = profiler->getTimeHistogram();
+    writeHistogram(os, &histogram[0], histogram.size());
+  } else {
+    os << "{}";
+  }
+
+  os << ",\"cloneSizeHistogram\":";
+  writeHistogram(os, stats::cloneSizes, 65);
+
+  os << ",\"statesByIteration\":{";
+  for (std::map<int, uint64_t>::iterator it = iterations.begin(),
+                                         ie = iterations.end();
+       it != ie; ++it) {
+    if (it != iterations.begin())
+      os << ",";
+    os << "\"" << it->first << "\":" << it->second;
+  }
+  os << "}}\n";
+  os.flush();
+
+  if (metricsFile) {
+    *metricsFile << line;
+    metricsFile->flush();
+  }
+
+  if (listenSocket != -1) {
+    acceptClients();
+    // Clients that are gone or too slow to keep up are dropped.
+    for (unsigned i = 0; i < clients.size();) {
+      if (send(clients[i], line.data(), line.size(), MSG_NOSIGNAL) !=
+          (ssize_t) line.size()) {
+        close(clients[i]);
+        clients.erase(clients.begin() + i);
+      } else {
+        i++;
+      }
+    }
+  }
+}
+
+void MetricsTracker::done() {
+  writeMetricsLine();
+}
@@ -0,0 +1,57 @@
+//===-- MetricsTracker.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_METRICSTRACKER_H
+#define KLEE_METRICSTRACKER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class raw_fd_ostream;
+}
+
+namespace klee {
+  class Executor;
+
+  /// MetricsTracker - Periodically writes a snapshot of the counters that
+  /// describe the progress of a run, one JSON object per line, to a file in
+  /// the output directory and/or to the clients of a local Unix socket. It
+  /// only reads statistics that are maintained anyway, so it costs nothing
+  /// between writes and is not created at all when disabled.
+  class MetricsTracker {
+    friend class WriteMetricsTimer;
+
+    Executor &executor;
+
+    llvm::raw_fd_ostream *metricsFile;
+    int listenSocket;
+    std::vector<int> clients;
+
+    double startWallTime;
+    double lastWallTime;
+    uint64_t lastInstructions;
+
+    void openSocket(const std::string &path);
+    void acceptClients();
+    void writeMetricsLine();
+
+  public:
+    static bool useMetrics();
+
+    MetricsTracker(Executor &_executor);
+    ~MetricsTracker();
+
+    /// Write a last snapshot at the end of the run.
+    void done();
+  };
+}
+
+#endif
@@ -0,0 +1,110 @@
+//===-- QueryProfiler.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryProfiler.h"
+
+#include "klee/Constraints.h"
+#include "klee/ExecutionState.h"
+#include "klee/Solver.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "klee/util/Bits.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace klee;
+
+/// Number of distinct nodes in the query.
+static uint64_t querySize(const Query &query) {
+  std::vector<ref<Expr> > stack(query.constraints.begin(),
+                                query.constraints.end());
+  stack.push_back(query.expr);
+  std::set<const Expr *> visited;
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back();
+    stack.pop_back();
+    if (!visited.insert(e.get()).second)
+      continue;
+    for (unsigned i = 0; i < e->getNumKids(); i++)
+      stack.push_back(e->getKid(i));
+  }
+  return visited.size();
+}
+
+void QueryProfiler::record(const ExecutionState &state, const Query &query,
+                           uint64_t usec) {
+  origins[phases.empty() ? "other" : phases.back()]++;
+  timeHistogram[bits64::numBits(usec)]++;
+  if (!detailed)
+    return;
+
+  std::string key;
+  llvm::raw_string_ostream os(key);
+  if (phases.empty())
+    os << "other;";
+  for (std::vector<const char *>::iterator it = phases.begin(),
+         ie = phases.end(); it != ie; ++it)
+    os << *it << ";";
+
+  // The instruction being executed; prevPC is only unset before the first
+  // step.
+  const KInstruction *ki = state.prevPC ? state.prevPC : state.pc;
+  if (ki && !ki->info->file.empty()) {
+    os << ki->info->file << ":" << ki->info->line;
+  } else if (!state.stack.empty()) {
+    os << state.stack.back().kf->function->getName();
+  } else {
+    os << "?";
+  }
+
+  CallSite &site = callSites[os.str()];
+  uint64_t size = querySize(query);
+  site.count++;
+  site.time += usec;
+  site.size += size;
+  site.timeHistogram[bits64::numBits(usec)]++;
+  site.sizeHistogram[bits64::numBits(size)]++;
+}
+
+void QueryProfiler::writeFolded(llvm::raw_ostream &os) {
+  for (std::map<std::string, CallSite>::iterator it = callSites.begin(),
+         ie = callSites.end(); it != ie; ++it)
+    os << it->first << " " << it->second.time << "\n";
+}
+
+static void writeHistogram(llvm::raw_ostream &os, const char *name,
+                           const std::vector<uint64_t> &histogram) {
+  os << "  " << name << ":";
+  for (unsigned i = 0; i < histogram.size(); i++)
+    if (histogram[i])
+      os << " <2^" << i << ":" << histogram[i];
+  os << "\n";
+}
+
+void QueryProfiler::writeHistograms(llvm::raw_ostream &os) {
+  std::vector<std::pair<uint64_t, std::string> > order;
+  for (std::map<std::string, CallSite>::iterator it = callSites.begin(),
+         ie = callSites.end(); it != ie; ++it)
+    order.push_back(std::make_pair(it->second.time, it->first));
+  std::sort(order.rbegin(), order.rend());
+
+  for (unsigned i = 0; i < order.size(); i++) {
+    const CallSite &site = callSites[order[i].second];
+    os << order[i].second << "\n"
+       << "  queries: " << site.count << ", time (us): " << site.time
+       << ", mean size (nodes): " << site.size / site.count << "\n";
+    writeHistogram(os, "time (us)", site.timeHistogram);
+    writeHistogram(os, "size (nodes)", site.sizeHistogram);
+  }
+}
@@ -0,0 +1,103 @@
+//===-- QueryProfiler.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYPROFILER_H
+#define KLEE_QUERYPROFILER_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace klee {
+  class ExecutionState;
+  struct Query;
+
+  /// QueryProfiler - Attributes solver queries to the phase of the analysis
+  /// that made them and to the source line being executed at the time.
+  class QueryProfiler {
+  public:
+    /// Phase - Names the phase that queries made while it is in scope belong
+    /// to. Phases nest, so the profile records the whole stack of them. A
+    /// null profiler makes this a no-op.
+    class Phase {
+      QueryProfiler *profiler;
+
+    public:
+      Phase(QueryProfiler *_profiler, const char *name)
+        : profiler(_profiler) {
+        if (profiler)
+          profiler->phases.push_back(name);
+      }
+      ~Phase() {
+        if (profiler)
+          profiler->phases.pop_back();
+      }
+    };
+
+  private:
+    struct CallSite {
+      uint64_t count;
+      uint64_t time;
+      uint64_t size;
+      /// Counts of queries by log2 of their time and size.
+      std::vector<uint64_t> timeHistogram;
+      std::vector<uint64_t> sizeHistogram;
+
+      CallSite() : count(0), time(0), size(0),
+                   timeHistogram(65), sizeHistogram(65) {}
+    };
+
+    std::vector<const char *> phases;
+    /// Whether to attribute queries to call sites, or only count them.
+    bool detailed;
+    /// [phase;...;phase;file:line] -> statistics
+    std::map<std::string, CallSite> callSites;
+    /// [innermost phase] -> number of queries
+    std::map<std::string, uint64_t> origins;
+    /// Counts of all queries by log2 of their time.
+    std::vector<uint64_t> timeHistogram;
+
+  public:
+    explicit QueryProfiler(bool _detailed = true)
+      : detailed(_detailed), timeHistogram(65) {}
+
+    bool isDetailed() const { return detailed; }
+
+    /// getOrigins - The number of queries made by each innermost phase. These
+    /// are counted even when not profiling in detail, as that is cheap.
+    const std::map<std::string, uint64_t> &getOrigins() const {
+      return origins;
+    }
+
+    /// getTimeHistogram - The number of queries that took less than 2^i
+    /// microseconds, at index i. Also kept when not profiling in detail.
+    const std::vector<uint64_t> &getTimeHistogram() const {
+      return timeHistogram;
+    }
+
+    /// record - Account a query that took the given number of microseconds.
+    void record(const ExecutionState &state, const Query &query,
+                uint64_t usec);
+
+    /// writeFolded - Write the total time per call site, one call site per
+    /// line in the folded stack format used by flame graph tools.
+    void writeFolded(llvm::raw_ostream &os);
+
+    /// writeHistograms - Write the query count, time and size of every call
+    /// site, most expensive first.
+    void writeHistograms(llvm::raw_ostream &os);
+  };
+}
+
+#endif
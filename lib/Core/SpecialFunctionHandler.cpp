@@ -143,6 +143,7 @@ static SpecialFunctionHandler::HandlerInfo handlerInfo[] = {
   add("__ubsan_handle_divrem_overflow", handleDivRemOverflow, false),
 
   add("castan_loop", handleCastanLoop, false),
+  add("castan_burst", handleCastanBurst, false),
 
 #undef addDNR
 #undef add  
@@ -790,7 +791,26 @@ void SpecialFunctionHandler::handleCastanLoop(ExecutionState &state,
                                 KInstruction *target,
                                 std::vector<ref<Expr> > &arguments) {
   assert(arguments.size()==0 && "invalid number of arguments to castan_loop");
+  executor.saveInitSnapshot(state);
+  executor.compactUpdateLists(state);
   if (state.cacheModel && !state.cacheModel->loop(state)) {
     executor.terminateStateOnExit(state);
   }
 }
+
+void SpecialFunctionHandler::handleCastanBurst(ExecutionState &state,
+                                KInstruction *target,
+                                std::vector<ref<Expr> > &arguments) {
+  assert(arguments.size()==1 && "invalid number of arguments to castan_burst");
+  ref<Expr> packets = executor.toUnique(state, arguments[0]);
+
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(packets)) {
+    if (state.cacheModel) {
+      state.cacheModel->burst(state, CE->getZExtValue());
+    }
+  } else {
+    executor.terminateStateOnError(state,
+                                   "castan_burst requires a constant arg",
+                                   Executor::User);
+  }
+}
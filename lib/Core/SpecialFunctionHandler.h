@@ -138,6 +138,7 @@ namespace klee {
     HANDLER(handleSubOverflow);
     HANDLER(handleDivRemOverflow);
     HANDLER(handleCastanLoop);
+    HANDLER(handleCastanBurst);
 #undef HANDLER
   };
 } // End klee namespace
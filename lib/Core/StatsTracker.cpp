@@ -17,6 +17,7 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/SpillArena.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/SolverStats.h"
@@ -111,7 +112,28 @@ namespace {
   UseCallPaths("use-call-paths",
 	       cl::init(true),
                cl::desc("Enable calltree tracking for instruction level statistics (default=on)"));
-  
+
+  cl::opt<unsigned>
+  IStatsSampleInterval("istats-sample-interval",
+                       cl::init(1),
+                       cl::desc("Attribute only one in n instructions, weighted by n, to instruction level "
+                                "statistics; coverage is still tracked exactly (default=1)"));
+
+  enum StatsProfile {
+    FullStats,
+    CastanStats
+  };
+
+  cl::opt<StatsProfile>
+  StatsProfileOpt("stats-profile",
+                  cl::desc("Select which statistics to maintain (default=full)"),
+                  cl::values(clEnumValN(FullStats, "full",
+                                        "All statistics, as selected by the other options"),
+                             clEnumValN(CastanStats, "castan",
+                                        "Only what CASTAN uses: run.stats without "
+                                        "instruction level statistics, call paths or coverage"),
+                             clEnumValEnd),
+                  cl::init(FullStats));
 }
 
 ///
@@ -187,7 +209,27 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     numBranches(0),
     fullBranches(0),
     partialBranches(0),
-    updateMinDistToUncovered(_updateMinDistToUncovered) {
+    updateMinDistToUncovered(_updateMinDistToUncovered),
+    instructionsUntilStatsWrite(StatsWriteAfterInstructions),
+    instructionsUntilIStatsWrite(IStatsWriteAfterInstructions),
+    instructionsUntilIStatsSample(1) {
+
+  if (IStatsSampleInterval == 0)
+    klee_error("--istats-sample-interval must be at least 1.");
+
+  bool trackCoverage = true;
+  if (StatsProfileOpt == CastanStats) {
+    // The CASTAN searcher does not look at coverage, so none of the per
+    // instruction accounting is needed.
+    if (updateMinDistToUncovered) {
+      klee_warning("--stats-profile=castan ignored, the selected searcher "
+                   "needs instruction level statistics");
+    } else {
+      OutputIStats = false;
+      UseCallPaths = false;
+      trackCoverage = false;
+    }
+  }
 
   if (StatsWriteAfterInstructions > 0 && StatsWriteInterval > 0)
     klee_error("Both options --stats-write-interval and "
@@ -218,13 +260,15 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
     }
   }
 
+  // Instructions that are not sampled are attributed to an extra index that
+  // is never written out.
   if (OutputIStats)
-    theStatisticManager->useIndexedStats(km->infos->getMaxID());
+    theStatisticManager->useIndexedStats(km->infos->getMaxID() + 1);
 
   for (std::vector<KFunction*>::iterator it = km->functions.begin(), 
          ie = km->functions.end(); it != ie; ++it) {
     KFunction *kf = *it;
-    kf->trackCoverage = 1;
+    kf->trackCoverage = trackCoverage;
 
     for (unsigned i=0; i<kf->numInstructions; ++i) {
       KInstruction *ki = kf->instructions[i];
@@ -310,7 +354,9 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     Instruction *inst = es.pc->inst;
     const InstructionInfo &ii = *es.pc->info;
     StackFrame &sf = es.stack.back();
+    // Coverage is accounted exactly, before sampling applies.
     theStatisticManager->setIndex(ii.id);
+    theStatisticManager->setIndexedScale(1);
     if (UseCallPaths)
       theStatisticManager->setContext(&sf.callPathNode->statistics);
 
@@ -331,15 +377,31 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
 	stats::uncoveredInstructions += (uint64_t)-1;
       }
     }
+
+    // A sampled instruction counts for the whole interval, so that the
+    // totals in run.istats keep their scale.
+    if (--instructionsUntilIStatsSample == 0) {
+      instructionsUntilIStatsSample = IStatsSampleInterval;
+      theStatisticManager->setIndexedScale(IStatsSampleInterval);
+    } else {
+      theStatisticManager->setIndex(executor.kmodule->infos->getMaxID());
+      theStatisticManager->setContext(0);
+    }
   }
 
-  if (statsFile && StatsWriteAfterInstructions &&
-      stats::instructions % StatsWriteAfterInstructions.getValue() == 0)
-    writeStatsLine();
+  // Count down rather than reading the instructions statistic on every
+  // step.
+  if (instructionsUntilStatsWrite && --instructionsUntilStatsWrite == 0) {
+    instructionsUntilStatsWrite = StatsWriteAfterInstructions;
+    if (statsFile)
+      writeStatsLine();
+  }
 
-  if (istatsFile && IStatsWriteAfterInstructions &&
-      stats::instructions % IStatsWriteAfterInstructions.getValue() == 0)
-    writeIStats();
+  if (instructionsUntilIStatsWrite && --instructionsUntilIStatsWrite == 0) {
+    instructionsUntilIStatsWrite = IStatsWriteAfterInstructions;
+    if (istatsFile)
+      writeIStats();
+  }
 }
 
 ///
@@ -380,7 +442,17 @@ void StatsTracker::framePopped(ExecutionState &es) {
 void StatsTracker::markBranchVisited(ExecutionState *visitedTrue, 
                                      ExecutionState *visitedFalse) {
   if (OutputIStats) {
-    unsigned id = theStatisticManager->getIndex();
+    // Branch coverage is exact, whether or not the branch was sampled.
+    ExecutionState *es = visitedTrue ? visitedTrue : visitedFalse;
+    unsigned id = es->prevPC->info->id;
+    unsigned sampledIndex = theStatisticManager->getIndex();
+    StatisticRecord *sampledContext = theStatisticManager->getContext();
+    uint64_t sampledScale = theStatisticManager->getIndexedScale();
+    theStatisticManager->setIndex(id);
+    theStatisticManager->setIndexedScale(1);
+    if (UseCallPaths)
+      theStatisticManager->setContext(&es->stack.back().callPathNode->statistics);
+
     uint64_t hasTrue = theStatisticManager->getIndexedValue(stats::trueBranches, id);
     uint64_t hasFalse = theStatisticManager->getIndexedValue(stats::falseBranches, id);
     if (visitedTrue && !hasTrue) {
@@ -398,6 +470,10 @@ void StatsTracker::markBranchVisited(ExecutionState *visitedTrue,
       if (hasTrue) { ++fullBranches; --partialBranches; }
       else ++partialBranches;
     }
+
+    theStatisticManager->setIndex(sampledIndex);
+    theStatisticManager->setContext(sampledContext);
+    theStatisticManager->setIndexedScale(sampledScale);
   }
 }
 
@@ -420,6 +496,7 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'SpillUsage',"
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -438,7 +515,8 @@ void StatsTracker::writeStatsLine() {
              << "," << numBranches
              << "," << util::getUserTime()
              << "," << executor.states.size()
-             << "," << util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize()
+             << "," << util::GetTotalMallocUsage() + executor.memory->getUsedDeterministicSize() +
+                       util::GetSpillArenaResidentUsage()
              << "," << stats::queries
              << "," << stats::queryConstructs
              << "," << 0 // was numObjects
@@ -450,6 +528,7 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << util::GetSpillArenaUsage()
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
@@ -46,6 +46,11 @@ namespace klee {
 
     bool updateMinDistToUncovered;
 
+    /// Instructions left until the next write or istats sample.
+    uint64_t instructionsUntilStatsWrite;
+    uint64_t instructionsUntilIStatsWrite;
+    unsigned instructionsUntilIStatsSample;
+
   public:
     static bool useStatistics();
 
@@ -16,6 +16,7 @@
 #include "klee/Internal/System/Time.h"
 
 #include "CoreStats.h"
+#include "QueryProfiler.h"
 
 #include "llvm/Support/TimeValue.h"
 
@@ -24,6 +25,22 @@ using namespace llvm;
 
 /***/
 
+TimingSolver::~TimingSolver() {
+  delete solver;
+  delete profiler;
+}
+
+void TimingSolver::account(const ExecutionState &state, const Query &query,
+                           const sys::TimeValue &start) {
+  sys::TimeValue delta = util::getWallTimeVal();
+  delta -= start;
+  stats::solverTime += delta.usec();
+  state.queryCost += delta.usec()/1000000.;
+
+  if (profiler)
+    profiler->record(state, query, delta.usec());
+}
+
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
                             Solver::Validity &result) {
   // Fast path, to avoid timer and OS overhead.
@@ -37,12 +54,10 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->evaluate(Query(state.constraints, expr), result);
+  Query query(state.constraints, expr);
+  bool success = solver->evaluate(query, result);
 
-  sys::TimeValue delta = util::getWallTimeVal();
-  delta -= now;
-  stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  account(state, query, now);
 
   return success;
 }
@@ -60,12 +75,10 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
   if (simplifyExprs)
     expr = state.constraints.simplifyExpr(expr);
 
-  bool success = solver->mustBeTrue(Query(state.constraints, expr), result);
+  Query query(state.constraints, expr);
+  bool success = solver->mustBeTrue(query, result);
 
-  sys::TimeValue delta = util::getWallTimeVal();
-  delta -= now;
-  stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  account(state, query, now);
 
   return success;
 }
@@ -95,6 +108,12 @@ bool TimingSolver::mayBeFalse(const ExecutionState& state, ref<Expr> expr,
 
 bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr, 
                             ref<ConstantExpr> &result) {
+  return getValue(state, state.constraints, expr, result);
+}
+
+bool TimingSolver::getValue(const ExecutionState& state,
+                            const ConstraintManager &constraints,
+                            ref<Expr> expr, ref<ConstantExpr> &result) {
   // Fast path, to avoid timer and OS overhead.
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(expr)) {
     result = CE;
@@ -104,14 +123,12 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
   sys::TimeValue now = util::getWallTimeVal();
 
   if (simplifyExprs)
-    expr = state.constraints.simplifyExpr(expr);
+    expr = constraints.simplifyExpr(expr);
 
-  bool success = solver->getValue(Query(state.constraints, expr), result);
+  Query query(constraints, expr);
+  bool success = solver->getValue(query, result);
 
-  sys::TimeValue delta = util::getWallTimeVal();
-  delta -= now;
-  stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  account(state, query, now);
 
   return success;
 }
@@ -127,15 +144,11 @@ TimingSolver::getInitialValues(const ExecutionState& state,
 
   sys::TimeValue now = util::getWallTimeVal();
 
-  bool success = solver->getInitialValues(Query(state.constraints,
-                                                ConstantExpr::alloc(0, Expr::Bool)), 
-                                          objects, result);
-  
-  sys::TimeValue delta = util::getWallTimeVal();
-  delta -= now;
-  stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
-  
+  Query query(state.constraints, ConstantExpr::alloc(0, Expr::Bool));
+  bool success = solver->getInitialValues(query, objects, result);
+
+  account(state, query, now);
+
   return success;
 }
 
@@ -13,10 +13,13 @@
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 
+#include "llvm/Support/TimeValue.h"
+
 #include <vector>
 
 namespace klee {
   class ExecutionState;
+  class QueryProfiler;
   class Solver;  
 
   /// TimingSolver - A simple class which wraps a solver and handles
@@ -25,6 +28,8 @@ namespace klee {
   public:
     Solver *solver;
     bool simplifyExprs;
+    /// profiler - Where to account queries, if profiling them.
+    QueryProfiler *profiler;
 
   public:
     /// TimingSolver - Construct a new timing solver.
@@ -33,10 +38,8 @@ namespace klee {
     /// simplified (via the constraint manager interface) prior to
     /// querying.
     TimingSolver(Solver *_solver, bool _simplifyExprs = true) 
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
-    ~TimingSolver() {
-      delete solver;
-    }
+      : solver(_solver), simplifyExprs(_simplifyExprs), profiler(0) {}
+    ~TimingSolver();
 
     void setTimeout(double t) {
       solver->setCoreSolverTimeout(t);
@@ -59,12 +62,22 @@ namespace klee {
     bool getValue(const ExecutionState &, ref<Expr> expr, 
                   ref<ConstantExpr> &result);
 
+    /// getValue - Get a value for expr under constraints, which must imply
+    /// the state's own constraints (e.g. extend them), accounting the query
+    /// to the state.
+    bool getValue(const ExecutionState &, const ConstraintManager &constraints,
+                  ref<Expr> expr, ref<ConstantExpr> &result);
+
     bool getInitialValues(const ExecutionState&, 
                           const std::vector<const Array*> &objects,
                           std::vector< std::vector<unsigned char> > &result);
 
     std::pair< ref<Expr>, ref<Expr> >
     getRange(const ExecutionState&, ref<Expr> query);
+
+  private:
+    void account(const ExecutionState &, const Query &,
+                 const llvm::sys::TimeValue &start);
   };
 
 }
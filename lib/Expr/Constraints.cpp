@@ -57,17 +57,18 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  typedef ImmutableMap< ref<Expr>, ref<Expr> > replacements_ty;
+  const replacements_ty &replacements;
 
 public:
-  ExprReplaceVisitor2(const std::map< ref<Expr>, ref<Expr> > &_replacements) 
+  ExprReplaceVisitor2(const replacements_ty &_replacements) 
     : ExprVisitor(true),
       replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) {
-    std::map< ref<Expr>, ref<Expr> >::const_iterator it =
-      replacements.find(ref<Expr>(const_cast<Expr*>(&e)));
-    if (it!=replacements.end()) {
+    const replacements_ty::value_type *it =
+      replacements.lookup(ref<Expr>(const_cast<Expr*>(&e)));
+    if (it) {
       return Action::changeTo(it->second);
     } else {
       return Action::doChildren();
@@ -75,11 +76,17 @@ public:
   }
 };
 
+// Only remember this many simplifications between constraint additions.
+static const unsigned MaxSimplifiedCacheSize = 4096;
+
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
   ConstraintManager::constraints_ty old;
   bool changed = false;
 
   constraints.swap(old);
+  equalities = equalities_ty();
+  simplified.clear();
+  generation = nextStamp();
   for (ConstraintManager::constraints_ty::iterator 
          it = old.begin(), ie = old.end(); it != ie; ++it) {
     ref<Expr> &ce = *it;
@@ -89,7 +96,7 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
       addConstraintInternal(e); // enable further reductions
       changed = true;
     } else {
-      constraints.push_back(ce);
+      pushConstraint(ce);
     }
   }
 
@@ -101,28 +108,41 @@ void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
 }
 
 ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
-  if (isa<ConstantExpr>(e))
+  if (isa<ConstantExpr>(e) || equalities.empty())
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-  
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(std::make_pair(*it,
-                                         ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(std::make_pair(*it,
-                                       ConstantExpr::alloc(1, Expr::Bool)));
+  std::map< ref<Expr>, ref<Expr> >::iterator it = simplified.find(e);
+  if (it != simplified.end())
+    return it->second;
+
+  ref<Expr> result = ExprReplaceVisitor2(equalities).visit(e);
+  if (simplified.size() >= MaxSimplifiedCacheSize)
+    simplified.clear();
+  simplified.insert(std::make_pair(e, result));
+  return result;
+}
+
+unsigned ConstraintManager::nextStamp() {
+  static unsigned stamp = 0;
+  return ++stamp;
+}
+
+void ConstraintManager::pushConstraint(ref<Expr> e) {
+  constraints.push_back(e);
+  simplified.clear();
+  generation = nextStamp();
+
+  // The first constraint to mention an expression determines its
+  // substitution.
+  ref<Expr> key = e, value = ConstantExpr::alloc(1, Expr::Bool);
+  if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+    if (isa<ConstantExpr>(ee->left)) {
+      key = ee->right;
+      value = ee->left;
     }
   }
-
-  return ExprReplaceVisitor2(equalities).visit(e);
+  if (!equalities.count(key))
+    equalities = equalities.insert(std::make_pair(key, value));
 }
 
 void ConstraintManager::addConstraintInternal(ref<Expr> e) {
@@ -155,12 +175,12 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 	rewriteConstraints(visitor);
       }
     }
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
 }
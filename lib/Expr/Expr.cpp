@@ -21,7 +21,13 @@
 
 #include "klee/util/ExprPPrinter.h"
 
+#include <ciso646>
 #include <sstream>
+#ifdef _LIBCPP_VERSION
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
 
 using namespace klee;
 using namespace llvm;
@@ -31,12 +37,66 @@ namespace {
   ConstArrayOpt("const-array-opt",
 	 cl::init(false),
 	 cl::desc("Enable various optimizations involving all-constant arrays."));
+
+  cl::opt<bool>
+  UseExprInterning("use-expr-interning",
+                   cl::init(true),
+                   cl::desc("Share a single node between structurally equal "
+                            "expressions (default=on)"));
+
+  // Live interned expressions by hash. Keyed on the hash rather than the
+  // expression so that ~Expr can unregister a node without calling into the
+  // already destroyed subclass.
+#ifdef _LIBCPP_VERSION
+  typedef std::unordered_multimap<unsigned, Expr *> InternTable;
+#else
+  typedef std::tr1::unordered_multimap<unsigned, Expr *> InternTable;
+#endif
+
+  InternTable &getInternTable() {
+    // Never destroyed, as expressions held in static objects may outlive it.
+    static InternTable *table = new InternTable();
+    return *table;
+  }
 }
 
 /***/
 
 unsigned Expr::count = 0;
 
+Expr::~Expr() {
+  Expr::count--;
+
+  if (interned) {
+    InternTable &table = getInternTable();
+    std::pair<InternTable::iterator, InternTable::iterator> range =
+        table.equal_range(hashValue);
+    for (InternTable::iterator it = range.first; it != range.second; ++it) {
+      if (it->second == this) {
+        table.erase(it);
+        break;
+      }
+    }
+  }
+}
+
+Expr *Expr::internNode(Expr *e) {
+  if (!UseExprInterning)
+    return e;
+
+  InternTable &table = getInternTable();
+  std::pair<InternTable::iterator, InternTable::iterator> range =
+      table.equal_range(e->hashValue);
+  for (InternTable::iterator it = range.first; it != range.second; ++it) {
+    if (it->second->compare(*e) == 0)
+      return it->second;
+  }
+
+  table.insert(std::make_pair(e->hashValue, e));
+  e->interned = true;
+  return e;
+}
+
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
 
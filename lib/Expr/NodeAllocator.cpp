@@ -0,0 +1,88 @@
+//===-- NodeAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "NodeAllocator.h"
+
+#include "klee/Expr.h"
+
+#include <new>
+#include <stdlib.h>
+
+using namespace klee;
+
+namespace {
+const size_t Granularity = 16;
+const size_t MaxNodeSize = 256;
+const size_t NumSizeClasses = MaxNodeSize / Granularity;
+const size_t SlabSize = 64 * 1024;
+const size_t CacheLineSize = 64;
+
+struct FreeNode {
+  FreeNode *next;
+};
+
+// Zero-initialized before any constructor runs, so nodes may be allocated
+// and freed during static initialization and destruction.
+FreeNode *freeLists[NumSizeClasses];
+
+void refill(size_t sizeClass) {
+  void *slab;
+  if (posix_memalign(&slab, CacheLineSize, SlabSize))
+    throw std::bad_alloc();
+
+  size_t nodeSize = (sizeClass + 1) * Granularity;
+  char *pos = (char *)slab, *end = pos + SlabSize - nodeSize;
+  for (; pos <= end; pos += nodeSize) {
+    FreeNode *node = (FreeNode *)pos;
+    node->next = freeLists[sizeClass];
+    freeLists[sizeClass] = node;
+  }
+}
+}
+
+void *NodeAllocator::allocate(size_t size) {
+  if (size == 0 || size > MaxNodeSize)
+    return ::operator new(size);
+
+  size_t sizeClass = (size - 1) / Granularity;
+  if (!freeLists[sizeClass])
+    refill(sizeClass);
+
+  FreeNode *node = freeLists[sizeClass];
+  freeLists[sizeClass] = node->next;
+  return node;
+}
+
+void NodeAllocator::deallocate(void *ptr, size_t size) {
+  if (!ptr)
+    return;
+  if (size == 0 || size > MaxNodeSize) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  size_t sizeClass = (size - 1) / Granularity;
+  FreeNode *node = (FreeNode *)ptr;
+  node->next = freeLists[sizeClass];
+  freeLists[sizeClass] = node;
+}
+
+void *Expr::operator new(size_t size) { return NodeAllocator::allocate(size); }
+
+void Expr::operator delete(void *ptr, size_t size) {
+  NodeAllocator::deallocate(ptr, size);
+}
+
+void *UpdateNode::operator new(size_t size) {
+  return NodeAllocator::allocate(size);
+}
+
+void UpdateNode::operator delete(void *ptr, size_t size) {
+  NodeAllocator::deallocate(ptr, size);
+}
@@ -0,0 +1,31 @@
+//===-- NodeAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_NODEALLOCATOR_H
+#define KLEE_NODEALLOCATOR_H
+
+#include <stddef.h>
+
+namespace klee {
+
+/// Pool allocator for expression and update nodes.
+///
+/// Nodes are rounded up to a multiple of 16 bytes and carved out of 64 KB
+/// slabs, one free list per size class. Only the slabs are cache-line
+/// aligned: nodes are packed back to back, so e.g. 48-byte nodes may
+/// straddle two lines. Freed nodes go back on their free list; slabs are
+/// never returned to the system. Sizes above the largest class fall through
+/// to the global operator new.
+namespace NodeAllocator {
+void *allocate(size_t size);
+void deallocate(void *ptr, size_t size);
+}
+}
+
+#endif
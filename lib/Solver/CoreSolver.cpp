@@ -61,6 +61,44 @@ static klee::Solver *handleMetaSMT() {
 
 namespace klee {
 
+static Solver *createPortfolioCoreSolver() {
+  std::vector<CoreSolverType> backends(PortfolioSolverBackends.begin(),
+                                       PortfolioSolverBackends.end());
+  if (backends.empty()) {
+#ifdef ENABLE_STP
+    backends.push_back(STP_SOLVER);
+#endif
+#ifdef ENABLE_Z3
+    backends.push_back(Z3_SOLVER);
+#endif
+#ifdef ENABLE_METASMT
+    backends.push_back(METASMT_SOLVER);
+#endif
+  }
+
+  std::vector<Solver *> solvers;
+  std::vector<std::string> names;
+  for (unsigned i = 0; i < backends.size(); i++) {
+    Solver *solver = createCoreSolver(backends[i]);
+    if (!solver)
+      continue;
+    solvers.push_back(solver);
+    names.push_back(backends[i] == STP_SOLVER
+                        ? "stp"
+                        : backends[i] == Z3_SOLVER ? "z3" : "metasmt");
+  }
+
+  if (solvers.empty())
+    return NULL;
+  if (solvers.size() == 1) {
+    llvm::errs() << "Only one portfolio backend available, not racing\n";
+    return solvers[0];
+  }
+  llvm::errs() << "Using portfolio of " << solvers.size()
+               << " solver backends\n";
+  return createPortfolioSolver(solvers, names);
+}
+
 Solver *createCoreSolver(CoreSolverType cst) {
   switch (cst) {
   case STP_SOLVER:
@@ -89,6 +127,8 @@ Solver *createCoreSolver(CoreSolverType cst) {
     llvm::errs() << "Not compiled with Z3 support\n";
     return NULL;
 #endif
+  case PORTFOLIO_SOLVER:
+    return createPortfolioCoreSolver();
   case NO_SOLVER:
     llvm::errs() << "Invalid solver\n";
     return NULL;
@@ -0,0 +1,381 @@
+//===-- PersistentCachingSolver.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/file.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+/// Writes a query in a form that only depends on its structure: arrays are
+/// numbered in order of first appearance rather than named, and shared
+/// subexpressions and update lists are written once and referenced by id.
+class QuerySerializer {
+private:
+  std::string buffer;
+  raw_string_ostream os;
+  std::map<const Expr *, unsigned> exprIds;
+  std::map<const Array *, unsigned> arrayIds;
+  std::map<const UpdateNode *, unsigned> updateIds;
+
+  void writeArray(const Array *array) {
+    std::map<const Array *, unsigned>::iterator it = arrayIds.find(array);
+    if (it != arrayIds.end()) {
+      os << " A" << it->second;
+      return;
+    }
+
+    unsigned id = arrayIds.size();
+    arrayIds[array] = id;
+    os << " (A" << id << " " << array->size << " " << array->domain << " "
+       << array->range;
+    for (std::vector<ref<ConstantExpr> >::const_iterator
+             it = array->constantValues.begin(),
+             ie = array->constantValues.end();
+         it != ie; ++it)
+      write(*it);
+    os << ")";
+  }
+
+  void writeUpdates(const UpdateNode *head) {
+    // Write the updates not seen before oldest first, so that every node
+    // only refers to nodes that have already been numbered.
+    std::vector<const UpdateNode *> fresh;
+    const UpdateNode *un = head;
+    for (; un && !updateIds.count(un); un = un->next)
+      fresh.push_back(un);
+
+    os << " (U";
+    if (un)
+      os << " U" << updateIds[un];
+    for (std::vector<const UpdateNode *>::reverse_iterator
+             it = fresh.rbegin(),
+             ie = fresh.rend();
+         it != ie; ++it) {
+      unsigned id = updateIds.size();
+      updateIds[*it] = id;
+      os << " (" << id;
+      write((*it)->index);
+      write((*it)->value);
+      os << ")";
+    }
+    os << ")";
+  }
+
+public:
+  QuerySerializer() : os(buffer) {}
+
+  void write(const ref<Expr> &e) {
+    std::map<const Expr *, unsigned>::iterator it = exprIds.find(e.get());
+    if (it != exprIds.end()) {
+      os << " #" << it->second;
+      return;
+    }
+
+    os << " (";
+    Expr::printKind(os, e->getKind());
+    os << " " << e->getWidth();
+
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      os << " " << ce->getAPValue().toString(16, false);
+    } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      os << " " << ee->offset;
+    } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      writeArray(re->updates.root);
+      writeUpdates(re->updates.head);
+    }
+
+    for (unsigned i = 0; i < e->getNumKids(); i++)
+      write(e->getKid(i));
+    os << ")";
+
+    unsigned id = exprIds.size();
+    exprIds[e.get()] = id;
+  }
+
+  void write(const Array *array) { writeArray(array); }
+
+  void write(const char *tag) { os << " " << tag; }
+
+  std::string digest() {
+    MD5 hash;
+    hash.update(os.str());
+    MD5::MD5Result result;
+    hash.final(result);
+
+    std::string hex;
+    raw_string_ostream hexOS(hex);
+    for (unsigned i = 0; i < 16; i++)
+      hexOS << hexdigit(result[i] >> 4, true)
+            << hexdigit(result[i] & 0xF, true);
+    return hexOS.str();
+  }
+};
+}
+
+/// A cache of core solver results that persists across runs.
+///
+/// Entries are keyed by a digest of the canonical form of the query and
+/// stored, one per line, in an append-only log. The log is read on startup
+/// and appended to under an exclusive lock, so concurrent runs can share it;
+/// entries written by other runs become visible on the next start.
+class PersistentCachingSolver : public SolverImpl {
+private:
+  Solver *solver;
+  std::string path;
+  int fd;
+  std::map<std::string, std::string> cache;
+
+  std::string getKey(const char *kind, const Query &query,
+                     const std::vector<const Array *> *objects = 0) {
+    QuerySerializer serializer;
+    serializer.write(kind);
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it)
+      serializer.write(*it);
+    serializer.write("Q");
+    serializer.write(query.expr);
+    if (objects) {
+      serializer.write("O");
+      for (std::vector<const Array *>::const_iterator it = objects->begin(),
+                                                      ie = objects->end();
+           it != ie; ++it)
+        serializer.write(*it);
+    }
+    return serializer.digest();
+  }
+
+  bool lookup(const std::string &key, std::string &result) {
+    std::map<std::string, std::string>::iterator it = cache.find(key);
+    if (it == cache.end()) {
+      ++stats::queryPersistentCacheMisses;
+      return false;
+    }
+    ++stats::queryPersistentCacheHits;
+    result = it->second;
+    return true;
+  }
+
+  void insert(const std::string &key, const std::string &result) {
+    cache[key] = result;
+    if (fd < 0)
+      return;
+
+    // Append the whole record with a single write, so that readers never
+    // see interleaved records from concurrent runs.
+    std::string record = key + " " + result + "\n";
+    if (flock(fd, LOCK_EX) == 0) {
+      if (write(fd, record.data(), record.size()) != (ssize_t)record.size())
+        klee_warning("unable to append to query cache %s", path.c_str());
+      flock(fd, LOCK_UN);
+    }
+  }
+
+  /// Drops a record left incomplete by a run that died while appending it,
+  /// so that the next record does not run into it. Called with the lock held.
+  void dropIncompleteRecord() {
+    off_t end = lseek(fd, 0, SEEK_END);
+    off_t pos = end;
+    char buffer[4096];
+    while (pos > 0) {
+      off_t start = pos > (off_t)sizeof(buffer) ? pos - sizeof(buffer) : 0;
+      ssize_t n = pread(fd, buffer, pos - start, start);
+      if (n != pos - start)
+        return;
+      while (n > 0 && buffer[n - 1] != '\n')
+        n--;
+      pos = start + n;
+      if (n > 0)
+        break;
+    }
+    if (pos != end && ftruncate(fd, pos) != 0)
+      klee_warning("unable to truncate query cache %s", path.c_str());
+  }
+
+  void load() {
+    std::ifstream in(path.c_str());
+    std::string line;
+    unsigned entries = 0;
+    // A record is only complete once its newline has been written.
+    while (std::getline(in, line) && !in.eof()) {
+      size_t space = line.find(' ');
+      if (space == std::string::npos)
+        continue;
+      cache[line.substr(0, space)] = line.substr(space + 1);
+      entries++;
+    }
+    klee_message("Loaded %u entries from query cache %s", entries,
+                 path.c_str());
+  }
+
+public:
+  PersistentCachingSolver(Solver *s, const std::string &path)
+      : solver(s), path(path) {
+    fd = open(path.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+      klee_warning("unable to open query cache %s for writing", path.c_str());
+    else if (flock(fd, LOCK_EX) == 0) {
+      dropIncompleteRecord();
+      flock(fd, LOCK_UN);
+    }
+    load();
+  }
+
+  ~PersistentCachingSolver() {
+    if (fd >= 0)
+      close(fd);
+    delete solver;
+  }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(double timeout);
+};
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  std::string key = getKey("V", query), cached;
+  if (lookup(key, cached)) {
+    result = (Solver::Validity)atoi(cached.c_str());
+    return true;
+  }
+
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+
+  std::stringstream ss;
+  ss << (int)result;
+  insert(key, ss.str());
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query,
+                                           bool &isValid) {
+  std::string key = getKey("T", query), cached;
+  if (lookup(key, cached)) {
+    isValid = cached == "1";
+    return true;
+  }
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+
+  insert(key, isValid ? "1" : "0");
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  std::string key = getKey("E", query), cached;
+  if (lookup(key, cached)) {
+    std::stringstream ss(cached);
+    Expr::Width width;
+    std::string value;
+    ss >> width >> value;
+    result = ConstantExpr::alloc(APInt(width, value, 16));
+    return true;
+  }
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+
+  // Only concrete values can be cached.
+  if (ConstantExpr *ce = dyn_cast<ConstantExpr>(result)) {
+    std::stringstream ss;
+    ss << ce->getWidth() << " " << ce->getAPValue().toString(16, false);
+    insert(key, ss.str());
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  std::string key = getKey("S", query, &objects), cached;
+  if (lookup(key, cached)) {
+    std::stringstream ss(cached);
+    ss >> hasSolution;
+    if (hasSolution) {
+      for (unsigned i = 0; i < objects.size(); i++) {
+        std::string hex;
+        ss >> hex;
+        hex.erase(0, 1);
+        std::vector<unsigned char> data(objects[i]->size);
+        for (unsigned j = 0; j < data.size() && 2 * j + 1 < hex.size(); j++)
+          data[j] = strtoul(hex.substr(2 * j, 2).c_str(), NULL, 16);
+        values.push_back(data);
+      }
+    }
+    return true;
+  }
+
+  if (!solver->impl->computeInitialValues(query, objects, values,
+                                          hasSolution))
+    return false;
+
+  std::string record;
+  raw_string_ostream ss(record);
+  ss << (hasSolution ? "1" : "0");
+  if (hasSolution) {
+    for (unsigned i = 0; i < values.size(); i++) {
+      // Objects may be empty; keep a placeholder so fields stay aligned.
+      ss << " -";
+      for (unsigned j = 0; j < values[i].size(); j++)
+        ss << hexdigit(values[i][j] >> 4, true)
+           << hexdigit(values[i][j] & 0xF, true);
+    }
+  }
+  insert(key, ss.str());
+  return true;
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *_solver,
+                                            std::string path) {
+  return new Solver(new PersistentCachingSolver(_solver, path));
+}
@@ -0,0 +1,370 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/SolverStats.h"
+#include "klee/Statistics.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <errno.h>
+#include <map>
+#include <poll.h>
+#include <set>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> PortfolioLearnQueries(
+    "portfolio-learn-queries", cl::init(8),
+    cl::desc("Number of races per query class before sending the class "
+             "straight to the backend that won most of them; 0 always races "
+             "(default=8)"));
+
+enum PortfolioResult {
+  PORTFOLIO_SOLVABLE,
+  PORTFOLIO_UNSOLVABLE,
+  PORTFOLIO_FAILURE
+};
+
+/// The message a racing child sends back once its slot is filled in.
+struct PortfolioReport {
+  unsigned char backend;
+  unsigned char result;
+};
+}
+
+/// Runs every backend on each query in a forked child and takes the first
+/// answer, killing the other children.
+///
+/// Backends can't share a process while racing: expression reference counts
+/// and the expression intern table are not thread safe, so each contender
+/// gets a copy of the address space instead, as with --use-forked-solver.
+/// Queries are grouped into classes by the operations they use and their
+/// size; once a class has been raced often enough, its queries go directly
+/// to the backend that won most of its races, in process.
+class PortfolioSolverImpl : public SolverImpl {
+private:
+  std::vector<Solver *> solvers;
+  std::vector<std::string> names;
+  double timeout;
+  SolverRunStatus runStatusCode;
+
+  // [query class][backend] -> races won
+  std::map<unsigned, std::vector<unsigned> > wins;
+
+  unsigned classify(const Query &query);
+  bool race(unsigned queryClass, const Query &query,
+            const std::vector<const Array *> &objects,
+            std::vector<std::vector<unsigned char> > &values,
+            bool &hasSolution);
+
+public:
+  PortfolioSolverImpl(const std::vector<Solver *> &solvers,
+                      const std::vector<std::string> &names)
+      : solvers(solvers), names(names), timeout(0.0),
+        runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+    assert(solvers.size() == names.size() && "every backend needs a name");
+    assert(solvers.size() < 256 && "too many backends");
+  }
+  ~PortfolioSolverImpl();
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return solvers[0]->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(double _timeout);
+};
+
+PortfolioSolverImpl::~PortfolioSolverImpl() {
+  for (std::map<unsigned, std::vector<unsigned> >::iterator
+           it = wins.begin(),
+           ie = wins.end();
+       it != ie; ++it) {
+    std::string summary;
+    for (unsigned i = 0; i < solvers.size(); i++)
+      summary += " " + names[i] + "=" + llvm::utostr(it->second[i]);
+    klee_message("Portfolio query class %#x races won:%s", it->first,
+                 summary.c_str());
+  }
+
+  for (unsigned i = 0; i < solvers.size(); i++)
+    delete solvers[i];
+}
+
+/// The class of a query is the set of expensive operations it uses, in the
+/// high bits, and the log2 of its number of distinct nodes, in the low 8.
+unsigned PortfolioSolverImpl::classify(const Query &query) {
+  std::vector<ref<Expr> > stack(query.constraints.begin(),
+                                query.constraints.end());
+  stack.push_back(query.expr);
+  std::set<const Expr *> visited;
+  unsigned features = 0;
+
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back();
+    stack.pop_back();
+    if (!visited.insert(e.get()).second)
+      continue;
+
+    switch (e->getKind()) {
+    case Expr::Mul:
+      features |= 1 << 8;
+      break;
+    case Expr::UDiv:
+    case Expr::SDiv:
+    case Expr::URem:
+    case Expr::SRem:
+      features |= 1 << 9;
+      break;
+    case Expr::Shl:
+    case Expr::LShr:
+    case Expr::AShr:
+      features |= 1 << 10;
+      break;
+    case Expr::Xor:
+      features |= 1 << 11;
+      break;
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      if (!isa<ConstantExpr>(re->index))
+        features |= 1 << 12;
+      if (re->updates.head)
+        features |= 1 << 13;
+      break;
+    }
+    default:
+      break;
+    }
+
+    for (unsigned i = 0; i < e->getNumKids(); i++)
+      stack.push_back(e->getKid(i));
+  }
+
+  unsigned sizeClass = 0;
+  for (size_t n = visited.size(); n > 1; n >>= 1)
+    sizeClass++;
+  return features | sizeClass;
+}
+
+bool PortfolioSolverImpl::race(
+    unsigned queryClass, const Query &query,
+    const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  size_t slotSize = 0;
+  for (unsigned i = 0; i < objects.size(); i++)
+    slotSize += objects[i]->size;
+  size_t regionSize = std::max<size_t>(1, slotSize * solvers.size());
+
+  unsigned char *region =
+      (unsigned char *)mmap(NULL, regionSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    klee_warning("unable to map memory for portfolio solver");
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return false;
+  }
+  int fds[2];
+  if (pipe(fds) < 0) {
+    klee_warning("unable to create pipe for portfolio solver");
+    munmap(region, regionSize);
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  std::vector<pid_t> pids;
+  for (unsigned i = 0; i < solvers.size(); i++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for portfolio solver %s)", names[i].c_str());
+      continue;
+    }
+
+    if (pid == 0) {
+      // Own process group, so that killing a contender also kills any
+      // children its backend forked.
+      setpgid(0, 0);
+      close(fds[0]);
+
+      std::vector<std::vector<unsigned char> > childValues;
+      bool childHasSolution;
+      PortfolioReport report = {(unsigned char)i, PORTFOLIO_FAILURE};
+      if (solvers[i]->impl->computeInitialValues(query, objects, childValues,
+                                                 childHasSolution)) {
+        report.result =
+            childHasSolution ? PORTFOLIO_SOLVABLE : PORTFOLIO_UNSOLVABLE;
+        unsigned char *pos = region + i * slotSize;
+        for (unsigned j = 0; childHasSolution && j < childValues.size(); j++)
+          pos = std::copy(childValues[j].begin(), childValues[j].end(), pos);
+      }
+      if (write(fds[1], &report, sizeof(report)) != sizeof(report))
+        _exit(1);
+      _exit(0);
+    }
+    pids.push_back(pid);
+  }
+  close(fds[1]);
+
+  // Wait for the first success, or for every contender to give up. Allow
+  // the backends some slack over their own timeout before giving up on them.
+  int pollTimeout = timeout ? (int)(timeout * 2000) + 1000 : -1;
+  PortfolioReport winner = {0, PORTFOLIO_FAILURE};
+  for (unsigned reports = 0; reports < pids.size();) {
+    struct pollfd pfd = {fds[0], POLLIN, 0};
+    int res = poll(&pfd, 1, pollTimeout);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res <= 0)
+      break;
+
+    PortfolioReport report;
+    if (read(fds[0], &report, sizeof(report)) != sizeof(report))
+      break;
+    reports++;
+    if (report.result != PORTFOLIO_FAILURE) {
+      winner = report;
+      break;
+    }
+  }
+  close(fds[0]);
+
+  for (unsigned i = 0; i < pids.size(); i++) {
+    kill(-pids[i], SIGKILL);
+    kill(pids[i], SIGKILL);
+    int status;
+    while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  ++stats::queryPortfolioRaces;
+  bool success = winner.result != PORTFOLIO_FAILURE;
+  if (success) {
+    hasSolution = winner.result == PORTFOLIO_SOLVABLE;
+    if (hasSolution) {
+      unsigned char *pos = region + winner.backend * slotSize;
+      values = std::vector<std::vector<unsigned char> >(objects.size());
+      for (unsigned i = 0; i < objects.size(); i++) {
+        values[i].assign(pos, pos + objects[i]->size);
+        pos += objects[i]->size;
+      }
+    }
+    wins[queryClass][winner.backend]++;
+    runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                                : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  } else {
+    runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+  }
+
+  munmap(region, regionSize);
+  return success;
+}
+
+bool PortfolioSolverImpl::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char> > &values, bool &hasSolution) {
+  unsigned queryClass = classify(query);
+  std::vector<unsigned> &classWins = wins[queryClass];
+  classWins.resize(solvers.size());
+
+  unsigned races = 0, best = 0;
+  for (unsigned i = 0; i < solvers.size(); i++) {
+    races += classWins[i];
+    if (classWins[i] > classWins[best])
+      best = i;
+  }
+
+  if (PortfolioLearnQueries && races >= PortfolioLearnQueries) {
+    ++stats::queryPortfolioRouted;
+    if (solvers[best]->impl->computeInitialValues(query, objects, values,
+                                                  hasSolution)) {
+      runStatusCode = solvers[best]->impl->getOperationStatusCode();
+      return true;
+    }
+    // The favourite failed on this one; let the others have a go as well.
+    values.clear();
+  }
+
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  ++stats::queryCounterexamples;
+  if (!race(queryClass, query, objects, values, hasSolution))
+    return false;
+  if (hasSolution)
+    ++stats::queriesInvalid;
+  else
+    ++stats::queriesValid;
+  return true;
+}
+
+bool PortfolioSolverImpl::computeTruth(const Query &query, bool &isValid) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool PortfolioSolverImpl::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<const Array *> objects;
+  std::vector<std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  // Find the object used in the expression, and compute an assignment
+  // for them.
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(query.withFalse(), objects, values, hasSolution))
+    return false;
+  if (!hasSolution)
+    return false;
+
+  // Evaluate the expression with the computed assignment.
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+
+  return true;
+}
+
+void PortfolioSolverImpl::setCoreSolverTimeout(double _timeout) {
+  timeout = _timeout;
+  for (unsigned i = 0; i < solvers.size(); i++)
+    solvers[i]->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createPortfolioSolver(const std::vector<Solver *> &solvers,
+                                    const std::vector<std::string> &names) {
+  return new Solver(new PortfolioSolverImpl(solvers, names));
+}
@@ -16,10 +16,34 @@
 #include "klee/util/Assignment.h"
 #include "klee/util/ExprUtil.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 
+namespace {
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental",
+    llvm::cl::desc("Keep Z3 solvers alive across queries and only assert the "
+                   "constraints that differ from the previous query, using "
+                   "push/pop (default=off)"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> Z3IncrementalContexts(
+    "z3-incremental-contexts",
+    llvm::cl::desc("Number of incremental Z3 solvers to keep, each holding a "
+                   "different constraint prefix (default=4)"),
+    llvm::cl::init(4));
+}
+
 namespace klee {
 
+// A Z3 solver kept across queries. Each asserted constraint lives in its own
+// scope, so the solver can be rewound to any prefix of the constraints.
+struct Z3IncrementalContext {
+  ::Z3_solver solver;
+  std::vector<ref<Expr> > asserted;
+  uint64_t lastUse;
+};
+
 class Z3SolverImpl : public SolverImpl {
 private:
   Z3Builder *builder;
@@ -28,6 +52,11 @@ private:
   ::Z3_params solverParameters;
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
+  std::vector<Z3IncrementalContext> incrementalContexts;
+  uint64_t incrementalUseCount;
+
+  Z3IncrementalContext &
+  getIncrementalContext(const ConstraintManager &constraints);
 
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
@@ -48,6 +77,9 @@ public:
       timeoutInMilliSeconds = UINT_MAX;
     Z3_params_set_uint(builder->ctx, solverParameters, timeoutParamStrSymbol,
                        timeoutInMilliSeconds);
+    for (auto &context : incrementalContexts) {
+      Z3_solver_set_params(builder->ctx, context.solver, solverParameters);
+    }
   }
 
   bool computeTruth(const Query &, bool &isValid);
@@ -66,7 +98,7 @@ public:
 
 Z3SolverImpl::Z3SolverImpl()
     : builder(new Z3Builder(/*autoClearConstructCache=*/false)), timeout(0.0),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incrementalUseCount(0) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -75,6 +107,9 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  for (auto &context : incrementalContexts) {
+    Z3_solver_dec_ref(builder->ctx, context.solver);
+  }
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -162,24 +197,85 @@ bool Z3SolverImpl::computeInitialValues(
   return internalRunSolver(query, &objects, &values, hasSolution);
 }
 
+Z3IncrementalContext &
+Z3SolverImpl::getIncrementalContext(const ConstraintManager &constraints) {
+  // Pick the solver sharing the longest constraint prefix with the query.
+  Z3IncrementalContext *context = NULL;
+  unsigned prefix = 0;
+  for (auto &candidate : incrementalContexts) {
+    unsigned candidatePrefix = 0;
+    for (ConstraintManager::const_iterator it = constraints.begin(),
+                                           ie = constraints.end();
+         it != ie && candidatePrefix < candidate.asserted.size() &&
+         *it == candidate.asserted[candidatePrefix];
+         ++it) {
+      candidatePrefix++;
+    }
+
+    if (!context || candidatePrefix > prefix ||
+        (candidatePrefix == prefix && candidatePrefix == 0 &&
+         candidate.lastUse < context->lastUse)) {
+      context = &candidate;
+      prefix = candidatePrefix;
+    }
+  }
+
+  // Nothing in common: start a new solver while there is room, otherwise
+  // recycle the least recently used one.
+  if (!context ||
+      (prefix == 0 && incrementalContexts.size() < Z3IncrementalContexts)) {
+    Z3IncrementalContext newContext;
+    newContext.solver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, newContext.solver);
+    Z3_solver_set_params(builder->ctx, newContext.solver, solverParameters);
+    incrementalContexts.push_back(newContext);
+    context = &incrementalContexts.back();
+  }
+  context->lastUse = ++incrementalUseCount;
+
+  if (context->asserted.size() > prefix) {
+    Z3_solver_pop(builder->ctx, context->solver,
+                  context->asserted.size() - prefix);
+    context->asserted.resize(prefix);
+  }
+
+  ConstraintManager::const_iterator it = constraints.begin();
+  std::advance(it, prefix);
+  for (ConstraintManager::const_iterator ie = constraints.end(); it != ie;
+       ++it) {
+    Z3_solver_push(builder->ctx, context->solver);
+    Z3_solver_assert(builder->ctx, context->solver, builder->construct(*it));
+    context->asserted.push_back(*it);
+  }
+
+  return *context;
+}
+
 bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
   TimerStatIncrementer t(stats::queryTime);
-  // TODO: Does making a new solver for each query have a performance
-  // impact vs making one global solver and using push and pop?
   // TODO: is the "simple_solver" the right solver to use for
   // best performance?
-  Z3_solver theSolver = Z3_mk_simple_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+  Z3_solver theSolver;
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  for (ConstraintManager::const_iterator it = query.constraints.begin(),
-                                         ie = query.constraints.end();
-       it != ie; ++it) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+  if (Z3Incremental) {
+    // Reuse a solver that already holds a prefix of the constraints and
+    // scope the query expression so it can be retracted afterwards.
+    theSolver = getIncrementalContext(query.constraints).solver;
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    theSolver = Z3_mk_simple_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (ConstraintManager::const_iterator it = query.constraints.begin(),
+                                           ie = query.constraints.end();
+         it != ie; ++it) {
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+    }
   }
   ++stats::queries;
   if (objects)
@@ -201,7 +297,11 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(theSolver, satisfiable, objects, values,
                                        hasSolution);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  if (Z3Incremental) {
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  } else {
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+  }
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
@@ -0,0 +1,149 @@
+//===-- SpillArena.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/System/SpillArena.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+  /// Size of each mapping of the spill file.
+  const size_t ChunkSize = 256 << 20;
+  /// Allocation granularity.
+  const size_t Alignment = 64;
+  /// Smaller blocks, such as the pages of the bit masks, stay on the heap:
+  /// they are not worth a file page each and are mostly hot.
+  const size_t MinSpillableSize = 4096;
+
+  struct Chunk {
+    char *base;
+    size_t used;
+  };
+
+  struct SpillArena {
+    int fd;
+    off_t fileSize;
+    std::vector<Chunk> chunks;
+    /// Freed blocks by size.
+    std::map<size_t, std::vector<void *> > freeLists;
+    size_t usage;
+
+    SpillArena() : fd(-1), fileSize(0), usage(0) {}
+
+    bool contains(void *p) const {
+      for (std::vector<Chunk>::const_iterator it = chunks.begin(),
+             ie = chunks.end(); it != ie; ++it)
+        if ((char *) p >= it->base && (char *) p < it->base + ChunkSize)
+          return true;
+      return false;
+    }
+
+    bool grow() {
+      // Reserve the disk space now: a store to a page of a sparse file that
+      // the full disk cannot back raises SIGBUS.
+      if (posix_fallocate(fd, fileSize, ChunkSize) != 0)
+        return false;
+      void *base = mmap(0, ChunkSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                        fileSize);
+      if (base == MAP_FAILED)
+        return false;
+      fileSize += ChunkSize;
+      Chunk chunk = { (char *) base, 0 };
+      chunks.push_back(chunk);
+      return true;
+    }
+  };
+
+  SpillArena arena;
+}
+
+bool util::EnableSpillArena(const std::string &dir, std::string &error) {
+  if (arena.fd != -1)
+    return true;
+
+  std::string path = dir + "/klee-spill-XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back(0);
+  int fd = mkstemp(&name[0]);
+  if (fd == -1) {
+    error = strerror(errno);
+    return false;
+  }
+  // Nothing refers to the file by name, the space is freed on exit.
+  unlink(&name[0]);
+  arena.fd = fd;
+  return true;
+}
+
+void *util::AllocateSpillable(size_t size) {
+  if (arena.fd == -1 || size < MinSpillableSize || size > ChunkSize)
+    return ::operator new(size);
+
+  size = (size + Alignment - 1) & ~(Alignment - 1);
+  std::vector<void *> &freeList = arena.freeLists[size];
+  if (!freeList.empty()) {
+    void *p = freeList.back();
+    freeList.pop_back();
+    arena.usage += size;
+    return p;
+  }
+
+  if (arena.chunks.empty() ||
+      arena.chunks.back().used + size > ChunkSize) {
+    if (!arena.grow())
+      return ::operator new(size);
+  }
+  Chunk &chunk = arena.chunks.back();
+  void *p = chunk.base + chunk.used;
+  chunk.used += size;
+  arena.usage += size;
+  return p;
+}
+
+void util::FreeSpillable(void *p, size_t size) {
+  if (!p)
+    return;
+  if (!arena.contains(p)) {
+    ::operator delete(p);
+    return;
+  }
+
+  size = (size + Alignment - 1) & ~(Alignment - 1);
+  arena.freeLists[size].push_back(p);
+  arena.usage -= size;
+}
+
+size_t util::GetSpillArenaUsage() { return arena.usage; }
+
+size_t util::GetSpillArenaResidentUsage() {
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t resident = 0;
+  std::vector<unsigned char> pages;
+  for (std::vector<Chunk>::const_iterator it = arena.chunks.begin(),
+         ie = arena.chunks.end(); it != ie; ++it) {
+    size_t length = (it->used + pageSize - 1) & ~(pageSize - 1);
+    pages.resize(length / pageSize);
+    if (pages.empty() || mincore(it->base, length, &pages[0]) != 0)
+      continue;
+    for (unsigned i = 0; i < pages.size(); i++)
+      if (pages[i] & 1)
+        resident += pageSize;
+  }
+  return resident;
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Compares the analysis speed and memory footprint of CASTAN builds.
+#
+# Usage: bench-castan.sh <castan-binary>...
+#
+# Runs each binary on each NF in $EXAMPLES (default: the DPDK NOP, LPM and
+# NAT examples) and prints, as CSV, the NF, the binary, the number of
+# instructions executed, the wall-clock time, instructions per second and
+# the peak RSS in KB. $MAX_LOOPS (default 50) bounds each run.
+#
+# $FLAGS is a ';'-separated list of extra option sets; each binary runs once
+# with each of them. To measure the interpreter overhead of statistics
+# bookkeeping, for example:
+#
+#   FLAGS="--stats-profile=full;--stats-profile=castan" bench-castan.sh castan
+
+set -e
+
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+
+EXAMPLES=${EXAMPLES:-"dpdk-nop dpdk-lpm-da dpdk-lpm-btrie dpdk-nat-basichash"}
+MAX_LOOPS=${MAX_LOOPS:-50}
+FLAGS=${FLAGS:-""}
+
+if [ $# -eq 0 ]; then
+  echo "Usage: $0 <castan-binary>..." 1>&2
+  exit 1
+fi
+
+echo "nf,castan,flags,instructions,seconds,instructions/s,peak-rss-kb"
+
+for NF in $EXAMPLES; do
+  make -C $DIR/../examples/$NF nf.bc > /dev/null
+
+  for CASTAN in "$@"; do
+    IFS=';' read -ra FLAG_SETS <<< "$FLAGS"
+    [ ${#FLAG_SETS[@]} -eq 0 ] && FLAG_SETS=("")
+
+    for FLAG_SET in "${FLAG_SETS[@]}"; do
+      OUT_DIR=$(mktemp -d)
+      LOG=$(mktemp)
+
+      /usr/bin/time -f "%e %M" -o $LOG.time \
+        $CASTAN --max-loops=$MAX_LOOPS \
+                --worst-case-sym-indices \
+                -max-memory=10000 \
+                $FLAG_SET \
+                --output-dir=$OUT_DIR/klee-out \
+                $DIR/../examples/$NF/nf.bc > $LOG 2>&1
+
+      INSTRUCTIONS=$(awk '/total instructions =/ { print $NF; }' $LOG)
+      read ELAPSED RSS < $LOG.time
+
+      echo "$NF,$CASTAN,$FLAG_SET,$INSTRUCTIONS,$ELAPSED,$(echo "$INSTRUCTIONS / $ELAPSED" | bc),$RSS"
+
+      rm -rf $OUT_DIR $LOG $LOG.time
+    done
+  done
+done
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Validates CASTAN's cache model against the NF running on this machine.
+#
+# Usage: castan-validate.sh <pcap> [castan-validate options]...
+#
+# Run from an example directory (e.g. examples/dpdk-lpm-da). The NF is built
+# natively twice against include/castan/castan-native.h: once with clang's
+# load/store tracing, to record the address of every access made per packet,
+# and once without, to time each packet. castan-validate then replays the
+# accesses through the cache model and compares its per-packet predictions
+# with the measured latencies. Per-packet results go to validate.csv.
+#
+# The NF's DPDK allocations come from 1 GB hugepages, as under DPDK, so at
+# least one must be reserved (e.g. hugepagesz=1G hugepages=1 at boot).
+#
+# Environment:
+#   SRCS   - the NF sources (default: all .c files in the directory).
+#   CFLAGS - extra compiler flags.
+#   LDLIBS - extra libraries to link against.
+
+set -e
+
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+INCLUDE="$DIR/../include"
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 <pcap> [castan-validate options]..." 1>&2
+  exit 1
+fi
+
+PCAP="$1"
+shift
+
+SRCS=${SRCS:-$(ls *.c)}
+
+COMPILE="clang -x c++ -std=gnu++11 -O3 -DNDEBUG -g \
+    -I$INCLUDE/castan -I$INCLUDE -I.. -I. \
+    -Ibuild/include -I$RTE_SDK_BIN/include \
+    -include $RTE_SDK_BIN/include/rte_config.h \
+    -include $INCLUDE/castan/castan-native.h \
+    -Wno-deprecated-register $CFLAGS"
+
+$COMPILE -fsanitize-coverage=trace-loads,trace-stores \
+    -o nf-trace $SRCS -lstdc++ $LDLIBS
+$COMPILE -o nf-native $SRCS -lstdc++ $LDLIBS
+
+CASTAN_PCAP="$PCAP" CASTAN_TRACE=nf.trace ./nf-trace
+CASTAN_PCAP="$PCAP" CASTAN_TRACE=nf-native.trace ./nf-native
+
+castan-validate --csv=validate.csv "$@" nf.trace nf-native.trace
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+# Produces a table for CASTAN's --instruction-costs option.
+#
+# Usage: learn-instruction-costs.sh [<castan .cache> <measured latency csv>]...
+#
+# The per-opcode costs are timed natively with rdtsc by
+# util/instruction-costs.c on the machine running this script, which should be
+# the one the NF is measured on. Given pairs of the .cache file of a CASTAN
+# run that used these opcode costs, without an overhead entry, and the
+# latencies measured for the same packets (one per line, as for
+# learn-castan-costs.sh), the mean residual per packet, times the packets
+# sharing its iteration, is added to the model's FIXED_OVERHEAD_NS, which
+# those estimates already included, to give the per-iteration overhead. $CACHE_MODEL names the --cache-model the runs
+# used (default: contentionset).
+#
+# Example:
+#   learn-instruction-costs.sh > costs.txt
+#   castan --instruction-costs=costs.txt ... nf.bc
+#   # Measure the generated packets into actual.csv.
+#   learn-instruction-costs.sh klee-last/test000001.cache actual.csv > costs.txt
+
+set -e
+
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+
+case "${CACHE_MODEL:-contentionset}" in
+  contentionset) MODEL_HEADER=ContentionSetCacheModel.h ;;
+  generic) MODEL_HEADER=GenericCacheModel.h ;;
+  *) echo "Unknown cache model: $CACHE_MODEL" 1>&2; exit 1 ;;
+esac
+FIXED_OVERHEAD_NS=$(awk '/^#define FIXED_OVERHEAD_NS/ { print $3; }' \
+  $DIR/../../include/castan/Internal/$MODEL_HEADER)
+
+if [ $(($# % 2)) -ne 0 ]; then
+  echo "Usage: $0 [<castan .cache> <measured latency csv>]..." 1>&2
+  exit 1
+fi
+
+HARNESS=$(mktemp)
+cc -O2 -o $HARNESS $DIR/util/instruction-costs.c
+$HARNESS
+rm $HARNESS
+
+DATA_CSV=$(mktemp)
+while [ $# -gt 0 ]; do
+  # One line per packet: the estimate for each packet of the iteration (the
+  # "per Packet" line when CASTAN_BURST_SIZE > 1) and its packet count.
+  awk '
+    function flush() { for (i = 0; i < n; i++) print t "," n; }
+    /^Loop Iteration / { flush(); t = ""; n = 0; }
+    /Estimated Execution Time:/ { t = $4; n = 1; }
+    /Packets:/ { n = $2; }
+    /Estimated Execution Time per Packet:/ { t = $6; }
+    END { flush(); }' "$1" \
+    | paste -d , - "$2" >> $DATA_CSV
+  shift 2
+done
+
+if [ -s $DATA_CSV ]; then
+  awk -F , -v fixed=$FIXED_OVERHEAD_NS '
+    $1 != "" && $3 != "" { residual += ($3 - $1) * $2; n++; }
+    END {
+      if (n) {
+        printf "# FIXED_OVERHEAD_NS plus the mean residual over %d packets.\n", n;
+        printf "overhead %f\n", fixed + residual / n;
+      }
+    }' $DATA_CSV
+fi
+
+rm $DATA_CSV
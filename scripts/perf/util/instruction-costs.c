@@ -0,0 +1,112 @@
+// Times dependent chains of native operations with rdtsc and prints their
+// latency in ns per LLVM opcode, in the format read by --instruction-costs.
+// Memory operations are left out as the cache model accounts for them.
+//
+// Build with: cc -O2 -o instruction-costs instruction-costs.c
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define ITERATIONS 10000000
+#define REPETITIONS 5
+
+// Keeps the compiler from folding or hoisting the chain.
+#define BARRIER(x) __asm__ volatile("" : "+r"(x))
+#define FBARRIER(x) __asm__ volatile("" : "+x"(x))
+
+static inline uint64_t rdtsc(void) {
+  uint32_t lo, hi;
+  __asm__ volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double tsc_per_ns(void) {
+  double start = now();
+  uint64_t tsc = rdtsc();
+  while (now() - start < 0.2)
+    ;
+  return (rdtsc() - tsc) / ((now() - start) * 1e9);
+}
+
+static volatile uint64_t seed = 12345;
+static volatile double fseed = 1.000001;
+
+__attribute__((noinline)) static uint64_t callee(uint64_t x) {
+  BARRIER(x);
+  return x;
+}
+
+// Cycles per iteration of a loop running op on a dependent chain, keeping the
+// best of several runs.
+#define MEASURE(result, type, barrier, init, op)                               \
+  do {                                                                         \
+    uint64_t best = UINT64_MAX;                                                \
+    for (int r = 0; r < REPETITIONS; r++) {                                    \
+      type x = init, y = init;                                                 \
+      uint64_t start = rdtsc();                                                \
+      for (long i = 0; i < ITERATIONS; i++) {                                  \
+        op;                                                                    \
+        barrier(x);                                                            \
+      }                                                                        \
+      uint64_t cycles = rdtsc() - start;                                       \
+      (void)y;                                                                 \
+      if (cycles < best)                                                       \
+        best = cycles;                                                         \
+    }                                                                          \
+    result = (double)best / ITERATIONS;                                        \
+  } while (0)
+
+int main(void) {
+  double scale = tsc_per_ns();
+  double empty, cycles;
+
+  // The loop itself: a compare, a branch and an increment.
+  MEASURE(empty, uint64_t, BARRIER, seed, );
+  printf("# %f TSC ticks per ns, %f per empty iteration\n", scale, empty);
+  printf("opcode br %f\n", empty / scale);
+
+#define INTEGER(name, op)                                                      \
+  do {                                                                         \
+    MEASURE(cycles, uint64_t, BARRIER, seed | 1, op);                          \
+    printf("opcode %s %f\n", name,                                             \
+           (cycles > empty ? cycles - empty : 0) / scale);                     \
+  } while (0)
+#define FLOAT(name, op)                                                        \
+  do {                                                                         \
+    MEASURE(cycles, double, FBARRIER, fseed, op);                              \
+    printf("opcode %s %f\n", name,                                             \
+           (cycles > empty ? cycles - empty : 0) / scale);                     \
+  } while (0)
+
+  INTEGER("add", x = x + y);
+  INTEGER("sub", x = x - y);
+  INTEGER("mul", x = x * y);
+  INTEGER("udiv", x = (x | 1) / (y | 1) + y);
+  INTEGER("sdiv", x = (int64_t)(x | 1) / (int64_t)(y | 1) + y);
+  INTEGER("urem", x = (x + y) % (y | 1));
+  INTEGER("srem", x = (int64_t)(x + y) % (int64_t)(y | 1));
+  INTEGER("shl", x = x << (y & 7));
+  INTEGER("lshr", x = x >> (y & 7));
+  INTEGER("ashr", x = (int64_t)x >> (y & 7));
+  INTEGER("and", x = x & y);
+  INTEGER("or", x = x | y);
+  INTEGER("xor", x = x ^ y);
+  INTEGER("icmp", x = x < y);
+  INTEGER("select", x = (x & 1) ? x : y);
+  INTEGER("getelementptr", x = x + 8 * y);
+  INTEGER("call", x = callee(x));
+  FLOAT("fadd", x = x + y);
+  FLOAT("fsub", x = x - y);
+  FLOAT("fmul", x = x * y);
+  FLOAT("fdiv", x = x / y);
+  FLOAT("fcmp", x = x < y);
+
+  return 0;
+}
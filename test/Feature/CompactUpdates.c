@@ -0,0 +1,35 @@
+// RUN: %llvmgcc -emit-llvm -g -c -o %t1.bc %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --cache-model=none --compact-updates-threshold=4 --exit-on-error %t1.bc
+
+// Compacting the update lists at castan_loop() must not change what the
+// symbolic table reads back.
+
+#include <assert.h>
+
+void castan_loop();
+
+int main() {
+  unsigned char table[16] = { 0 };
+  unsigned i, j;
+  klee_make_symbolic(&i, sizeof(i), "i");
+  klee_make_symbolic(&j, sizeof(j), "j");
+  klee_assume(i < 16);
+  klee_assume(j < 16);
+
+  for (unsigned loop = 0; loop < 3; loop++) {
+    // Concrete writes, the older ones overwritten, then repeated writes to
+    // the same symbolic index.
+    for (unsigned k = 0; k < 8; k++)
+      table[k % 4] = k + loop;
+    for (unsigned k = 0; k < 8; k++)
+      table[i] = 10 + k + loop;
+
+    castan_loop();
+
+    assert(table[i] == 17 + loop);
+    assert(table[j] == (j == i ? 17 + loop : j < 4 ? 4 + j + loop : 0));
+  }
+
+  return 0;
+}
@@ -0,0 +1,42 @@
+// RUN: %llvmgcc -emit-llvm -g -c -o %t1.bc %s
+// RUN: rm -rf %t.snapshots %t.klee-out %t.klee-out2
+// RUN: mkdir %t.snapshots
+// RUN: %klee --output-dir=%t.klee-out --allocate-determ --cache-model=none --init-snapshot-dir=%t.snapshots --exit-on-error %t1.bc 2> %t.save.log
+// RUN: FileCheck %s -input-file=%t.save.log -check-prefix=CHECK-SAVE
+// RUN: %klee --output-dir=%t.klee-out2 --allocate-determ --cache-model=none --init-snapshot-dir=%t.snapshots --exit-on-error %t1.bc 2> %t.restore.log
+// RUN: FileCheck %s -input-file=%t.restore.log -check-prefix=CHECK-RESTORE
+
+// Function pointers stored during initialization are host addresses, which
+// have to be relocated when another run resumes from the snapshot.
+
+#include <assert.h>
+#include <errno.h>
+
+void castan_loop();
+
+typedef int (*handler_t)(int);
+
+static int add_one(int x) { return x + 1; }
+static int twice(int x) { return 2 * x; }
+
+struct table {
+  handler_t handlers[2];
+} table;
+
+int main() {
+  handler_t local = twice;
+  table.handlers[0] = add_one;
+  table.handlers[1] = twice;
+  errno = 42;
+
+  // CHECK-SAVE: saved init snapshot
+  // CHECK-RESTORE: resuming from init snapshot
+  castan_loop();
+
+  assert(table.handlers[0](1) == 2);
+  assert(table.handlers[1](3) == 6);
+  assert(local(4) == 8);
+  assert(errno == 42);
+
+  return 0;
+}
@@ -0,0 +1,32 @@
+// RUN: rm -rf %t.pcap %t.loops.pcap %t.out
+// RUN: ktest2pcap %S/Inputs/ktest2pcap/test000001.ktest %t.pcap
+// RUN: od -An -tx1 -v -w1000000 %t.pcap | FileCheck %s -check-prefix=CHECK-NIC0
+// RUN: ktest2pcap --loops=2 --rate=1000 %S/Inputs/ktest2pcap/test000001.ktest %t.loops.pcap all
+// RUN: od -An -tx1 -v -w1000000 %t.loops.pcap | FileCheck %s -check-prefix=CHECK-LOOPS
+// RUN: ktest2pcap --pcapng %S/Inputs/ktest2pcap %t.out
+// RUN: tr -c '[:print:]' '\n' < %t.out/test000001.pcapng | FileCheck %s -check-prefix=CHECK-NG
+
+// The test case holds a UDP packet on NIC 0, a TCP packet on NIC 1 and
+// another UDP packet on NIC 0, each 2000 ticks of a 2 GHz TSC (1 us) after
+// the previous one. The frames carry zero checksums and trailing padding.
+
+// Padding trimmed to the IP length, IP and UDP checksums filled in.
+// CHECK-NIC0: 00 00 00 00 01 00 00 00 2d 00 00 00 2d 00 00 00
+// CHECK-NIC0: 40 11 66 cc 0a 00 00 01 0a 00 00 02 04 d2 00 50 00 0b 22 51 61 62 63
+// CHECK-NIC0-NOT: 40 06
+// CHECK-NIC0: 00 00 00 00 03 00 00 00 2a 00 00 00 2a 00 00 00
+// CHECK-NIC0: 40 11 66 c7 0a 00 00 05 0a 00 00 06 00 35 00 35 00 08 eb 69
+
+// With all NICs, the TCP checksum is filled in too. The second repetition
+// starts 1 ms (one --rate period) after the end of the first.
+// CHECK-LOOPS: 02 00 00 00 36 00 00 00 36 00 00 00
+// CHECK-LOOPS: 40 06 66 ca 0a 00 00 03 0a 00 00 04 10 e1 01 bb
+// CHECK-LOOPS: 50 02 04 00 85 3f
+// CHECK-LOOPS: 00 00 00 00 eb 03 00 00 2d 00 00 00
+// CHECK-LOOPS: 00 00 00 00 ec 03 00 00 36 00 00 00
+// CHECK-LOOPS: 00 00 00 00 ed 03 00 00 2a 00 00 00
+
+// Without burst markers each packet is a loop iteration, numbered among the
+// packets of all NICs, so the second NIC 0 packet is iteration 2.
+// CHECK-NG: castan-burst=0 castan-predicted-ns=100.000000
+// CHECK-NG: castan-burst=2 castan-predicted-ns=300.000000
@@ -0,0 +1,39 @@
+// RUN: %llvmgcc -emit-llvm -g -c -o %t1.bc %s
+// RUN: rm -rf %t.klee-out %t.klee-out2 %t.klee-out3 %t.klee-out4 %t.cache %t.truncated
+// RUN: %klee --output-dir=%t.klee-out --query-cache-file=%t.cache %t1.bc 2> %t.log
+// RUN: FileCheck %s -input-file=%t.log -check-prefix=CHECK-EMPTY
+// RUN: FileCheck %s -input-file=%t.klee-out/info -check-prefix=CHECK-MISS
+// RUN: %klee --output-dir=%t.klee-out2 --query-cache-file=%t.cache %t1.bc
+// RUN: FileCheck %s -input-file=%t.klee-out2/info -check-prefix=CHECK-HIT
+
+// A record cut short by a run that died while appending is ignored, and the
+// next run's first record does not run into it.
+// RUN: head -n 1 %t.cache > %t.first
+// RUN: head -c 20 %t.cache > %t.truncated
+// RUN: %klee --output-dir=%t.klee-out3 --query-cache-file=%t.truncated %t1.bc 2> %t.truncated.log
+// RUN: FileCheck %s -input-file=%t.truncated.log -check-prefix=CHECK-EMPTY
+// RUN: head -n 1 %t.truncated | diff %t.first -
+// RUN: %klee --output-dir=%t.klee-out4 --query-cache-file=%t.truncated %t1.bc
+// RUN: FileCheck %s -input-file=%t.klee-out4/info -check-prefix=CHECK-HIT
+
+// CHECK-EMPTY: Loaded 0 entries from query cache
+// CHECK-MISS: query cache file hits = 0
+// CHECK-HIT: query cache file hits = {{[1-9][0-9]*}}
+// CHECK-HIT: query cache file misses = 0
+
+#include "klee/klee.h"
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  if (x > 10) {
+    if (y == x * 3)
+      return 1;
+    return 2;
+  }
+  if (x + y == 7)
+    return 3;
+  return 0;
+}
@@ -0,0 +1,183 @@
+//===-- castan-validate.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+// Replays memory traces recorded from a native run of an NF (see
+// include/castan/castan-native.h) through the cache model CASTAN uses, and
+// compares the latency it predicts for each packet with the one measured.
+
+#include "klee/ExecutionState.h"
+#include "castan/Internal/CacheModel.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace llvm;
+
+#define CASTAN_TRACE_MAGIC 0x43415354414e5452ull
+#define CASTAN_TRACE_END_PACKET (~0ull)
+
+namespace {
+cl::opt<std::string>
+    TracePath(cl::desc("<trace from an NF built with load/store tracing>"),
+              cl::Positional, cl::Required);
+
+cl::opt<std::string> TimingPath(
+    cl::desc("[trace from an uninstrumented build, to take timings from]"),
+    cl::Positional, cl::init(""));
+
+cl::opt<std::string>
+    CsvPath("csv", cl::desc("Write per-packet results to this CSV file"),
+            cl::init(""));
+
+cl::opt<unsigned long>
+    SkipPackets("skip-packets",
+                cl::desc("Leave the first packets out of the comparison, "
+                         "while the caches warm up (default=0)"),
+                cl::init(0));
+
+cl::opt<double> BucketWidth(
+    "bucket-width",
+    cl::desc("Width of the error histogram buckets, in percent (default=10)"),
+    cl::init(10));
+
+struct Packet {
+  uint64_t ticks;
+  uint64_t instructions;
+};
+
+class TraceReader {
+  std::ifstream file;
+  double ticksPerNs;
+
+public:
+  TraceReader(const std::string &path) : file(path, std::ios::binary) {
+    uint64_t magic, ticksWord;
+    if (!read(magic) || magic != CASTAN_TRACE_MAGIC || !read(ticksWord)) {
+      std::cerr << "Invalid trace file: " << path << "\n";
+      exit(1);
+    }
+    memcpy(&ticksPerNs, &ticksWord, sizeof(ticksPerNs));
+  }
+
+  double getTicksPerNs() { return ticksPerNs; }
+
+  bool read(uint64_t &word) {
+    return (bool)file.read((char *)&word, sizeof(word));
+  }
+
+  // Calls access for each access of the next packet, and returns whether
+  // there was one.
+  template <typename F> bool readPacket(Packet &packet, F access) {
+    uint64_t word;
+    while (read(word)) {
+      if (word == CASTAN_TRACE_END_PACKET) {
+        return read(packet.ticks) && read(packet.instructions);
+      }
+      access(word >> 1, word & 1);
+    }
+    return false;
+  }
+};
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, " castan-validate\n");
+
+  std::vector<klee::ref<klee::Expr>> assumptions;
+  klee::ExecutionState state(assumptions);
+  castan::CacheModel *cacheModel = state.cacheModel;
+  if (!cacheModel) {
+    std::cerr << "No cache model selected.\n";
+    return 1;
+  }
+
+  TraceReader trace(TracePath);
+  std::unique_ptr<TraceReader> timing;
+  if (!TimingPath.empty()) {
+    timing.reset(new TraceReader(TimingPath));
+  } else {
+    std::cerr << "Warning: timing the instrumented build, measured latencies "
+                 "include the tracing overhead.\n";
+  }
+
+  std::ofstream csv;
+  if (!CsvPath.empty()) {
+    csv.open(CsvPath);
+    csv << "packet,accesses,instructions,predicted-ns,measured-ns,error-%\n";
+  }
+
+  // [bucket] -> packets, by relative error of the prediction.
+  std::map<long, unsigned long> histogram;
+  double sumError = 0, sumAbsError = 0;
+  unsigned long compared = 0;
+
+  for (unsigned long i = 0;; i++) {
+    cacheModel->replayLoop();
+    unsigned long accesses = 0;
+    Packet packet;
+    if (!trace.readPacket(packet, [&](uint64_t address, bool isWrite) {
+          cacheModel->replayAccess(address, isWrite);
+          accesses++;
+        })) {
+      break;
+    }
+    double ticksPerNs = trace.getTicksPerNs();
+    if (timing) {
+      if (!timing->readPacket(packet, [](uint64_t, bool) {})) {
+        std::cerr << "Timing trace has fewer packets than the access trace.\n";
+        return 1;
+      }
+      ticksPerNs = timing->getTicksPerNs();
+    }
+    cacheModel->replayInstructions(packet.instructions);
+
+    double predicted = cacheModel->getIterationTime(i);
+    double measured = packet.ticks / ticksPerNs;
+    double error = measured ? 100 * (predicted - measured) / measured : 0;
+
+    if (csv.is_open()) {
+      csv << i << "," << accesses << "," << packet.instructions << ","
+          << predicted << "," << measured << "," << error << "\n";
+    }
+
+    if (i >= SkipPackets) {
+      histogram[(long)std::floor(error / BucketWidth)]++;
+      sumError += error;
+      sumAbsError += std::fabs(error);
+      compared++;
+    }
+  }
+
+  if (!compared) {
+    std::cerr << "No packets to compare.\n";
+    return 1;
+  }
+
+  std::cout << "Packets compared: " << compared << "\n";
+  std::cout << "Mean error: " << sumError / compared << "%\n";
+  std::cout << "Mean absolute error: " << sumAbsError / compared << "%\n";
+  std::cout << "Error histogram (prediction vs. measurement):\n";
+  for (auto bucket : histogram) {
+    std::cout << "  [" << std::setw(6) << bucket.first * BucketWidth << "%, "
+              << std::setw(6) << (bucket.first + 1) * BucketWidth
+              << "%): " << std::setw(8) << bucket.second << " "
+              << std::string(60 * bucket.second / compared, '#') << "\n";
+  }
+
+  return 0;
+}
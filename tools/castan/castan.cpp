@@ -12,6 +12,7 @@
 #include "castan/Internal/CacheModel.h"
 #include "castan/Internal/RainbowTable.h"
 
+#include "../../lib/Core/QueryProfiler.h"
 #include "../../lib/Core/TimingSolver.h"
 #include "klee/Config/Version.h"
 #include "klee/ExecutionState.h"
@@ -431,6 +432,9 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     exit(1);
   }
 
+  QueryProfiler::Phase phase(((Executor *)m_interpreter)->solver->profiler,
+                             "processTestCase");
+
   // [<packet array, [<[havoc input byte exprs], havoc output array>>]]
   std::vector<
       std::pair<const Array *,
@@ -494,6 +498,8 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     }
 
     // Check if havoc is consistent with path constraint.
+    QueryProfiler::Phase havocPhase(
+        ((Executor *)m_interpreter)->solver->profiler, "havoc reconciliation");
     ref<Expr> query = klee::ConstantExpr::create(1, Expr::Bool);
     unsigned int reconciled_havocs = 0;
     for (unsigned havoc_id = 0; havoc_id < objects.size(); havoc_id++) {
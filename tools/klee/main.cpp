@@ -1534,6 +1534,10 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t queryPersistentCacheHits =
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheHits");
+  uint64_t queryPersistentCacheMisses =
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheMisses");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1549,6 +1553,12 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (queryPersistentCacheHits || queryPersistentCacheMisses)
+    handler->getInfoStream()
+      << "KLEE: done: query cache file hits = " << queryPersistentCacheHits
+      << "\n"
+      << "KLEE: done: query cache file misses = "
+      << queryPersistentCacheMisses << "\n";
 
   std::stringstream stats;
   stats << "\n";
@@ -7,141 +7,537 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include <assert.h>
+#include <algorithm>
+#include <fstream>
 #include <string>
+#include <vector>
 
 #include "klee/Internal/ADT/KTest.h"
 
+#include "llvm/Support/CommandLine.h"
+
 #include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
 #include <netinet/if_ether.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
+#include <string.h>
+#include <sys/stat.h>
 
-#include <pcap/pcap.h>
+using namespace llvm;
 
-uint16_t checksum(const void *buf, size_t len) {
-  unsigned long sum = 0;
-  const uint16_t *pos = (const uint16_t *)buf;
+#define LINKTYPE_ETHERNET 1
 
-  while (len > 1) {
-    sum += *pos++;
-    if (sum & 0x80000000)
-      sum = (sum & 0xFFFF) + (sum >> 16);
-    len -= 2;
-  }
+namespace {
+enum TimestampMode { KTestTimestamps, ZeroTimestamps, RateTimestamps };
+
+cl::opt<std::string> InputPath(cl::desc("<ktest file | klee-out directory>"),
+                               cl::Positional, cl::Required);
+
+cl::opt<std::string> OutputPath(cl::desc("<pcap file | output directory>"),
+                                cl::Positional, cl::Required);
+
+cl::opt<std::string> NicId(cl::desc("[nic id | all]"), cl::Positional,
+                           cl::init("0"));
+
+cl::opt<unsigned long> NumPackets(cl::desc("[num packets]"), cl::Positional,
+                                  cl::init(0));
+
+cl::opt<TimestampMode> Timestamps(
+    "timestamps", cl::desc("Choose how packet timestamps are generated."),
+    cl::values(clEnumValN(KTestTimestamps, "ktest",
+                          "Use the inter-arrival times solved by CASTAN "
+                          "(default)"),
+               clEnumValN(ZeroTimestamps, "zero", "Set all timestamps to 0"),
+               clEnumValN(RateTimestamps, "rate",
+                          "Space packets evenly at --rate packets per second"),
+               clEnumValEnd),
+    cl::init(KTestTimestamps));
 
-  while (sum >> 16)
-    sum = (sum & 0xFFFF) + (sum >> 16);
+cl::opt<double> Rate("rate",
+                     cl::desc("Packet rate for --timestamps=rate, and gap "
+                              "between --loops repetitions otherwise, in "
+                              "packets per second (default=1000000)"),
+                     cl::init(1e6));
 
-  return ~sum;
+cl::opt<unsigned long>
+    Loops("loops", cl::desc("Repeat the packet sequence the given number of "
+                            "times (default=1)"),
+          cl::init(1));
+
+cl::opt<bool>
+    PcapNG("pcapng",
+           cl::desc("Write pcapng files, annotating each packet with the "
+                    "latency predicted in the .cache file (default=off)"),
+           cl::init(false));
+
+cl::opt<std::string>
+    CacheFile("cache-file",
+              cl::desc("Cache report to annotate packets with (defaults to "
+                       "the .cache file next to the .ktest file)"),
+              cl::init(""));
+
+cl::opt<unsigned> BufferSize("buffer-size",
+                             cl::desc("Output buffer size in KB (default=1024)"),
+                             cl::init(1024));
 }
 
-int main(int argc, char **argv) {
-  assert((argc >= 3 && argc <= 5) &&
-         "Usage: ktest2pcap <ktest-file> <pcap-file> [nic id] [num packets]");
+// One's complement sum over a stream of buffers, as used by the IP, TCP and
+// UDP checksums. Buffers may have odd lengths.
+class Checksum {
+private:
+  uint64_t sum;
+  bool odd;
+  uint8_t oddByte;
+
+public:
+  Checksum() : sum(0), odd(false), oddByte(0) {}
+
+  void add(const void *buf, size_t len) {
+    const uint8_t *pos = (const uint8_t *)buf;
+
+    if (odd && len > 0) {
+      sum += (oddByte << 8) | *pos++;
+      len--;
+      odd = false;
+    }
+    while (len > 1) {
+      sum += (pos[0] << 8) | pos[1];
+      pos += 2;
+      len -= 2;
+    }
+    if (len) {
+      oddByte = *pos;
+      odd = true;
+    }
+  }
+
+  // Returns the checksum in network byte order.
+  uint16_t finish() {
+    uint64_t s = sum;
+    if (odd) {
+      s += oddByte << 8;
+    }
+    while (s >> 16) {
+      s = (s & 0xFFFF) + (s >> 16);
+    }
+    return htons(~s & 0xFFFF);
+  }
+};
+
+// Buffered pcap / pcapng writer.
+class PacketWriter {
+private:
+  FILE *file;
+  bool pcapng;
+  std::vector<unsigned char> buffer;
+
+  void flush() {
+    if (!buffer.empty() &&
+        fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+      fprintf(stderr, "Error writing output file: %s\n", strerror(errno));
+    }
+    buffer.clear();
+  }
+
+  void append(const void *data, size_t len) {
+    if (buffer.size() + len > buffer.capacity()) {
+      flush();
+    }
+    buffer.insert(buffer.end(), (const unsigned char *)data,
+                  (const unsigned char *)data + len);
+  }
+
+  template <typename T> void append(T value) { append(&value, sizeof(value)); }
+
+  void appendPadding(size_t len) {
+    static const unsigned char zeros[4] = {0, 0, 0, 0};
+    append(zeros, (4 - len % 4) % 4);
+  }
+
+  static uint32_t padded(size_t len) { return (len + 3) & ~3; }
+
+public:
+  PacketWriter(const std::string &path, bool pcapng, size_t bufferSize)
+      : file(fopen(path.c_str(), "wb")), pcapng(pcapng) {
+    if (!file) {
+      return;
+    }
+    buffer.reserve(bufferSize);
+
+    if (pcapng) {
+      // Section header block.
+      append<uint32_t>(0x0A0D0D0A);
+      append<uint32_t>(28);
+      append<uint32_t>(0x1A2B3C4D);
+      append<uint16_t>(1);
+      append<uint16_t>(0);
+      append<int64_t>(-1);
+      append<uint32_t>(28);
+
+      // Interface description block with nanosecond timestamps.
+      append<uint32_t>(1);
+      append<uint32_t>(32);
+      append<uint16_t>(LINKTYPE_ETHERNET);
+      append<uint16_t>(0);
+      append<uint32_t>(65535);
+      append<uint16_t>(9); // if_tsresol
+      append<uint16_t>(1);
+      append<uint8_t>(9);
+      appendPadding(1);
+      append<uint32_t>(0); // opt_endofopt
+      append<uint32_t>(32);
+    } else {
+      append<uint32_t>(0xA1B2C3D4);
+      append<uint16_t>(2);
+      append<uint16_t>(4);
+      append<int32_t>(0);
+      append<uint32_t>(0);
+      append<uint32_t>(65535);
+      append<uint32_t>(LINKTYPE_ETHERNET);
+    }
+  }
+
+  ~PacketWriter() {
+    if (file) {
+      flush();
+      fclose(file);
+    }
+  }
+
+  bool good() { return file; }
+
+  void writePacket(uint64_t timestampNs,
+                   const std::vector<unsigned char> &data,
+                   const std::string &comment) {
+    if (pcapng) {
+      uint32_t optionsLength =
+          comment.empty() ? 0 : 4 + padded(comment.size()) + 4;
+      uint32_t blockLength = 32 + padded(data.size()) + optionsLength;
+
+      // Enhanced packet block.
+      append<uint32_t>(6);
+      append<uint32_t>(blockLength);
+      append<uint32_t>(0);
+      append<uint32_t>(timestampNs >> 32);
+      append<uint32_t>(timestampNs & 0xFFFFFFFF);
+      append<uint32_t>(data.size());
+      append<uint32_t>(data.size());
+      append(data.data(), data.size());
+      appendPadding(data.size());
+      if (!comment.empty()) {
+        append<uint16_t>(1); // opt_comment
+        append<uint16_t>(comment.size());
+        append(comment.data(), comment.size());
+        appendPadding(comment.size());
+        append<uint32_t>(0); // opt_endofopt
+      }
+      append<uint32_t>(blockLength);
+    } else {
+      append<uint32_t>(timestampNs / 1000000000);
+      append<uint32_t>(timestampNs % 1000000000 / 1000);
+      append<uint32_t>(data.size());
+      append<uint32_t>(data.size());
+      append(data.data(), data.size());
+    }
+  }
+};
+
+struct Packet {
+  std::vector<unsigned char> data;
+  uint64_t timestampNs;
+  long burst;
+};
+
+// Trims the frame to the IP datagram and recomputes the IP and L4 checksums.
+// Returns false if the headers are malformed, in which case the frame is left
+// untouched.
+static bool fixPacket(std::vector<unsigned char> &data) {
+  // Check if IP packet, possibly behind an 802.1Q tag.
+  if (data.size() < sizeof(struct ether_header)) {
+    fprintf(stderr, "Truncated Ethernet frame.\n");
+    return false;
+  }
+  unsigned l3_offset = sizeof(struct ether_header);
+  uint16_t l3_type = ntohs(((struct ether_header *)data.data())->ether_type);
+  if (l3_type == ETHERTYPE_VLAN) {
+    if (data.size() < l3_offset + 4) {
+      fprintf(stderr, "Truncated VLAN tag.\n");
+      return false;
+    }
+    l3_type = ntohs(*((uint16_t *)(data.data() + l3_offset + 2)));
+    l3_offset += 4;
+  }
+  if (l3_type != ETHERTYPE_IP) {
+    fprintf(stderr, "Packet with unsupported l3-type: %d\n", l3_type);
+    return false;
+  }
 
-  KTest *input = kTest_fromFile(argv[1]);
-  assert(input && "Error loading ktest file.");
+  // Extract IP header.
+  if (data.size() < l3_offset + sizeof(struct ip)) {
+    fprintf(stderr, "Truncated IP packet.\n");
+    return false;
+  }
+  struct ip *ip = (struct ip *)(data.data() + l3_offset);
+  if (ip->ip_v != 4) {
+    fprintf(stderr, "Unsupported IP version: %d\n", ip->ip_v);
+    return false;
+  }
+  unsigned ip_hlen = ip->ip_hl * 4;
+  unsigned ip_len = ntohs(ip->ip_len);
+  if (ip->ip_hl < 5 || ip_len < ip_hlen ||
+      data.size() < l3_offset + ip_len) {
+    fprintf(stderr, "Truncated IP packet.\n");
+    return false;
+  }
+  // Symbolic packets are allocated at the template's maximum size; drop the
+  // bytes beyond the IP datagram.
+  data.resize(l3_offset + ip_len);
+  ip = (struct ip *)(data.data() + l3_offset);
 
-  pcap_t *pcap = pcap_open_dead(DLT_EN10MB, 65536);
-  pcap_dumper_t *out = pcap_dump_open(pcap, argv[2]);
-  assert(out && "Error opening pcap file.");
+  unsigned char *l4 = data.data() + l3_offset + ip_hlen;
+  unsigned l4_len = ip_len - ip_hlen;
+  uint16_t *l4_check = NULL;
+  switch (ip->ip_p) {
+  case IPPROTO_TCP: {
+    struct tcphdr *tcp = (struct tcphdr *)l4;
+    if (l4_len < sizeof(struct tcphdr) || tcp->doff < 5) {
+      fprintf(stderr, "Truncated TCP segment.\n");
+    } else {
+      l4_check = &tcp->check;
+    }
+  } break;
+  case IPPROTO_UDP: {
+    struct udphdr *udp = (struct udphdr *)l4;
+    if (l4_len < sizeof(struct udphdr) || ntohs(udp->len) < 8) {
+      fprintf(stderr, "Truncated UDP datagram.\n");
+    } else {
+      l4_check = &udp->check;
+    }
+  } break;
+  default:
+    fprintf(stderr, "Packet with unsupported transport protocol: %d\n",
+            ip->ip_p);
+  }
 
-  int selected_nic = 0;
-  if (argc >= 4) {
-    selected_nic = atoi(argv[3]);
+  if (l4_check) {
+    // Pseudo-header, then the segment itself.
+    struct {
+      struct in_addr src, dst;
+      uint8_t zero, proto;
+      uint16_t len;
+    } __attribute__((packed)) pseudo = {ip->ip_src, ip->ip_dst, 0, ip->ip_p,
+                                        htons(l4_len)};
+    *l4_check = 0;
+    Checksum l4_sum;
+    l4_sum.add(&pseudo, sizeof(pseudo));
+    l4_sum.add(l4, l4_len);
+    *l4_check = l4_sum.finish();
+    if (ip->ip_p == IPPROTO_UDP && *l4_check == 0) {
+      *l4_check = 0xFFFF;
+    }
   }
 
-  long num_packets = 0;
-  if (argc >= 5) {
-    num_packets = atol(argv[4]);
+  ip->ip_sum = 0;
+  Checksum ip_sum;
+  ip_sum.add(ip, ip_hlen);
+  ip->ip_sum = ip_sum.finish();
+
+  return true;
+}
+
+// Reads the predicted latency of each loop iteration from a .cache report.
+static std::vector<double> loadPredictions(const std::string &path) {
+  std::vector<double> predictions;
+  std::ifstream file(path);
+
+  std::string line;
+  while (std::getline(file, line)) {
+    const std::string perPacket = "  Estimated Execution Time per Packet: ";
+    const std::string perIteration = "  Estimated Execution Time: ";
+    if (line.compare(0, 15, "Loop Iteration ") == 0) {
+      predictions.push_back(0);
+    } else if (!predictions.empty() &&
+               line.compare(0, perIteration.size(), perIteration) == 0) {
+      predictions.back() = std::stod(line.substr(perIteration.size()));
+    } else if (!predictions.empty() &&
+               line.compare(0, perPacket.size(), perPacket) == 0) {
+      predictions.back() = std::stod(line.substr(perPacket.size()));
+    }
   }
 
+  return predictions;
+}
+
+static bool convert(const std::string &ktestPath,
+                    const std::string &outputPath) {
+  KTest *input = kTest_fromFile(ktestPath.c_str());
+  if (!input) {
+    fprintf(stderr, "Error loading ktest file %s.\n", ktestPath.c_str());
+    return false;
+  }
+
+  // -1 selects packets from all NICs, interleaved in arrival order.
+  int selected_nic = NicId == "all" ? -1 : atoi(NicId.c_str());
+
+  std::vector<Packet> packets;
   int current_nic = 0;
+  // Bursts are delimited by castan_burst markers. Without markers, each
+  // packet is its own loop iteration.
+  long current_burst = -1;
+  // Arrival time of the current packet, from castan_time inter-arrival times.
+  // These are in TSC ticks of castan_tsc_hz when the test case records it,
+  // and in ns in test cases from older shims that do not.
+  uint64_t current_time = 0;
+  uint64_t tsc_hz = 0;
+  // Index of the current packet among those of all NICs, which is its loop
+  // iteration when there are no burst markers.
+  long current_packet = -1;
   for (unsigned i = 0; i < input->numObjects; i++) {
     KTestObject *o = &input->objects[i];
 
-    if (std::string(o->name) == "VIGOR_DEVICE") {
+    if (std::string(o->name) == "VIGOR_DEVICE" ||
+        std::string(o->name) == "castan_port") {
       current_nic = *((int *)o->bytes);
+    } else if (std::string(o->name) == "castan_tsc_hz") {
+      if (o->numBytes == sizeof(uint64_t) && *((uint64_t *)o->bytes)) {
+        tsc_hz = *((uint64_t *)o->bytes);
+      } else {
+        fprintf(stderr, "Ignoring malformed castan_tsc_hz object.\n");
+      }
+    } else if (std::string(o->name) == "castan_time") {
+      if (o->numBytes == sizeof(uint64_t)) {
+        current_time += *((uint64_t *)o->bytes);
+      } else {
+        fprintf(stderr, "Ignoring malformed castan_time object.\n");
+      }
+    } else if (std::string(o->name) == "castan_burst") {
+      current_burst++;
     } else if (std::string(o->name) == "castan_packet" ||
                std::string(o->name) == "user_buf") {
-      if (current_nic != selected_nic) {
-        fprintf(stderr, "Skipping packet for NIC %d\n", current_nic);
+      current_packet++;
+      if (selected_nic >= 0 && current_nic != selected_nic) {
         continue;
       }
 
-      struct pcap_pkthdr pkthdr = {
-          .ts = {.tv_sec = 0, .tv_usec = 0},
-          .caplen = o->numBytes,
-          .len = o->numBytes,
-      };
-
-      // Fix checksums.
-      // Check if IP packet.
-      assert(pkthdr.caplen >= sizeof(struct ether_header) &&
-             "Truncated Ethernet frame.");
-      if (ntohs(((struct ether_header *)o->bytes)->ether_type) !=
-          ETHERTYPE_IP) {
-        fprintf(stderr, "Packet with unsupported l3-type: %d\n",
-                ntohs(((struct ether_header *)o->bytes)->ether_type));
-      } else {
-        // Extract IP header.
-        assert(pkthdr.caplen >=
-                   sizeof(struct ether_header) + sizeof(struct ip) &&
-               "Truncated IP packet.");
-        struct ip *ip = (struct ip *)(o->bytes + sizeof(struct ether_header));
-        if (ip->ip_v != 4) {
-          fprintf(stderr, "Unsupported IP version: %d\n", ip->ip_v);
-        } else {
-          assert(ip->ip_hl >= 5 && "Truncated IP packet.");
-
-          ip->ip_sum = 0;
-
-          switch (ip->ip_p) {
-          case 0x06: { // TCP
-            assert(pkthdr.caplen >= sizeof(struct ether_header) +
-                                        ip->ip_hl * 4 + sizeof(struct tcphdr) &&
-                   "Truncated TCP segment.");
-            assert(ip->ip_len >= ip->ip_hl * 4 + sizeof(struct tcphdr) &&
-                   "Truncated TCP segment.");
-            struct tcphdr *tcp =
-                (struct tcphdr *)(((char *)ip) + ip->ip_hl * 4);
-            assert(tcp->doff >= 5 && "Truncated TCP segment.");
-
-            tcp->check = 0;
-          } break;
-          case 0x11: { // UDP
-            assert(pkthdr.caplen >= sizeof(struct ether_header) +
-                                        ip->ip_hl * 4 + sizeof(struct udphdr) &&
-                   "Truncated UDP datagram.");
-            assert(ip->ip_len >= ip->ip_hl * 4 + sizeof(struct udphdr) &&
-                   "Truncated UDP datagram.");
-            struct udphdr *udp =
-                (struct udphdr *)(((char *)ip) + ip->ip_hl * 4);
-            assert(ntohs(udp->len) >= 8 && "Truncated UDP datagram.");
-
-            udp->check = 0;
-          } break;
-          default:
-            fprintf(stderr, "Packet with unsupported transport protocol: %d\n",
-                    ip->ip_p);
-          }
-
-          ip->ip_sum = checksum(ip, ip->ip_hl * 4);
-        }
+      Packet packet;
+      packet.data.assign(o->bytes, o->bytes + o->numBytes);
+      packet.timestampNs =
+          tsc_hz ? current_time / tsc_hz * 1000000000 +
+                       current_time % tsc_hz * 1000000000 / tsc_hz
+                 : current_time;
+      packet.burst = current_burst >= 0 ? current_burst : current_packet;
+      fixPacket(packet.data);
+      packets.push_back(packet);
+
+      if (packets.size() == NumPackets) {
+        break;
       }
+    }
+  }
+  kTest_free(input);
 
-      pcap_dump((u_char *)out, &pkthdr, o->bytes);
+  std::vector<double> predictions;
+  if (PcapNG) {
+    std::string cachePath = CacheFile;
+    if (cachePath.empty() && ktestPath.size() > 6 &&
+        ktestPath.substr(ktestPath.size() - 6) == ".ktest") {
+      cachePath = ktestPath.substr(0, ktestPath.size() - 6) + ".cache";
+    }
+    predictions = loadPredictions(cachePath);
+  }
+
+  PacketWriter out(outputPath, PcapNG, BufferSize * 1024);
+  if (!out.good()) {
+    fprintf(stderr, "Error opening output file %s: %s\n", outputPath.c_str(),
+            strerror(errno));
+    return false;
+  }
 
-      if (--num_packets == 0) {
+  // Time between repetitions of the sequence. In ktest mode, the last packet
+  // of a repetition and the first of the next are one --rate period apart,
+  // so that repetitions never overlap, even without castan_time objects.
+  uint64_t period_ns = 0;
+  if (!packets.empty()) {
+    period_ns = Timestamps == RateTimestamps
+                    ? packets.size() * 1e9 / Rate
+                    : packets.back().timestampNs -
+                          packets.front().timestampNs + 1e9 / Rate;
+  }
+
+  for (unsigned long loop = 0; loop < Loops; loop++) {
+    for (unsigned long p = 0; p < packets.size(); p++) {
+      uint64_t timestamp_ns = 0;
+      switch (Timestamps) {
+      case KTestTimestamps:
+        timestamp_ns = loop * period_ns + packets[p].timestampNs;
+        break;
+      case ZeroTimestamps:
         break;
+      case RateTimestamps:
+        timestamp_ns = (loop * packets.size() + p) * 1e9 / Rate;
+        break;
+      }
+
+      std::string comment;
+      if (PcapNG && packets[p].burst < (long)predictions.size()) {
+        comment = "castan-burst=" + std::to_string(packets[p].burst) +
+                  " castan-predicted-ns=" +
+                  std::to_string(predictions[packets[p].burst]);
       }
+
+      out.writePacket(timestamp_ns, packets[p].data, comment);
     }
   }
 
-  pcap_close(pcap);
-  pcap_dump_close(out);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, " ktest2pcap\n");
+
+  if ((Timestamps == RateTimestamps || Loops > 1) && Rate <= 0) {
+    fprintf(stderr, "--rate must be positive.\n");
+    return 1;
+  }
+
+  struct stat st;
+  if (stat(InputPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    // Batch mode: convert every test case in a klee-out directory.
+    if (mkdir(OutputPath.c_str(), 0775) < 0 && errno != EEXIST) {
+      fprintf(stderr, "Error creating %s: %s\n", OutputPath.c_str(),
+              strerror(errno));
+      return 1;
+    }
+
+    DIR *dir = opendir(InputPath.c_str());
+    if (!dir) {
+      fprintf(stderr, "Error reading %s: %s\n", InputPath.c_str(),
+              strerror(errno));
+      return 1;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() > 6 && name.substr(name.size() - 6) == ".ktest") {
+        names.push_back(name.substr(0, name.size() - 6));
+      }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    int failures = 0;
+    for (auto name : names) {
+      fprintf(stderr, "Converting %s.\n", name.c_str());
+      if (!convert(InputPath + "/" + name + ".ktest",
+                   OutputPath + "/" + name + (PcapNG ? ".pcapng" : ".pcap"))) {
+        failures++;
+      }
+    }
+    return failures ? 1 : 0;
+  }
 
-  return 0;
+  return convert(InputPath, OutputPath) ? 0 : 1;
 }
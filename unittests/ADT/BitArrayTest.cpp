@@ -0,0 +1,77 @@
+//===-- BitArrayTest.cpp ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/util/BitArray.h"
+
+using namespace klee;
+
+namespace {
+
+// Pages hold 4096 bits, so this spans three pages.
+const unsigned Size = 10000;
+
+TEST(BitArrayTest, SetAndUnset) {
+  BitArray a(Size);
+  a.set(0);
+  a.set(4095);
+  a.set(4096);
+  a.set(Size - 1);
+  for (unsigned i = 0; i < Size; i++)
+    EXPECT_EQ(i == 0 || i == 4095 || i == 4096 || i == Size - 1, a.get(i));
+
+  a.unset(4096);
+  EXPECT_FALSE(a.get(4096));
+  EXPECT_TRUE(a.get(4095));
+
+  a.set(31, true);
+  a.set(32, false);
+  EXPECT_TRUE(a.get(31));
+  EXPECT_FALSE(a.get(32));
+}
+
+TEST(BitArrayTest, InitialValue) {
+  BitArray a(Size, true);
+  for (unsigned i = 0; i < Size; i++)
+    EXPECT_TRUE(a.get(i));
+  a.unset(5000);
+  EXPECT_FALSE(a.get(5000));
+  EXPECT_TRUE(a.get(4999));
+  EXPECT_TRUE(a.get(5001));
+}
+
+TEST(BitArrayTest, CopyOnWrite) {
+  BitArray a(Size);
+  a.set(10);
+  BitArray b(a, Size);
+  b.set(20);
+  b.unset(10);
+  EXPECT_TRUE(a.get(10));
+  EXPECT_FALSE(a.get(20));
+  EXPECT_FALSE(b.get(10));
+  EXPECT_TRUE(b.get(20));
+}
+
+TEST(BitArrayTest, UnchangedWritesDoNotAllocate) {
+  BitArray a(Size);
+  a.unset(100);
+  a.set(5000, false);
+  EXPECT_EQ(0u, a.getNumAllocatedPages());
+
+  BitArray b(Size, true);
+  b.set(100);
+  b.set(5000, true);
+  EXPECT_EQ(0u, b.getNumAllocatedPages());
+
+  b.unset(100);
+  EXPECT_EQ(1u, b.getNumAllocatedPages());
+}
+
+}
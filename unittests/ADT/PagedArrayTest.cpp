@@ -0,0 +1,192 @@
+//===-- PagedArrayTest.cpp --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/PagedArray.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+// Small pages, so that the tests cross page boundaries. 10 elements make two
+// full pages and a partial last one.
+typedef PagedArray<int, 4> Array;
+
+std::vector<int> contents(const Array &a) {
+  std::vector<int> result(a.getSize());
+  a.copyOut(&result[0]);
+  return result;
+}
+
+TEST(PagedArrayTest, Inline) {
+  Array a(3, 7);
+  EXPECT_EQ(0u, a.getNumAllocatedPages());
+  a.set(1, 5);
+  Array b(a);
+  b.set(2, 9);
+  EXPECT_EQ(7, a[0]);
+  EXPECT_EQ(5, a[1]);
+  EXPECT_EQ(7, a[2]);
+  EXPECT_EQ(9, b[2]);
+}
+
+TEST(PagedArrayTest, CopySize) {
+  // Inline arrays copy their elements, paged ones only their page table.
+  EXPECT_EQ(3 * sizeof(int), Array(3).getCopySize());
+  Array a(10);
+  for (unsigned i = 0; i < 10; i++)
+    a.set(i, i);
+  EXPECT_EQ(3 * sizeof(void *), a.getCopySize());
+}
+
+TEST(PagedArrayTest, CopySharesPages) {
+  Array a(10);
+  for (unsigned i = 0; i < 10; i++)
+    a.set(i, i);
+  EXPECT_EQ(3u, a.getNumAllocatedPages());
+
+  Array b(a);
+  for (unsigned i = 0; i < 10; i++) {
+    EXPECT_TRUE(a.sharesPage(b, i));
+    EXPECT_EQ((int) i, b[i]);
+  }
+}
+
+TEST(PagedArrayTest, WriteUnsharesOnlyItsPage) {
+  Array a(10);
+  for (unsigned i = 0; i < 10; i++)
+    a.set(i, i);
+  Array b(a);
+
+  b.set(5, 50);
+  EXPECT_EQ(5, a[5]);
+  EXPECT_EQ(50, b[5]);
+  EXPECT_TRUE(a.sharesPage(b, 0));
+  EXPECT_FALSE(a.sharesPage(b, 4));
+  EXPECT_TRUE(a.sharesPage(b, 8));
+
+  // Writing the original leaves the copy alone too.
+  a.set(0, 100);
+  EXPECT_EQ(100, a[0]);
+  EXPECT_EQ(0, b[0]);
+  EXPECT_FALSE(a.sharesPage(b, 0));
+}
+
+TEST(PagedArrayTest, PartialLastPage) {
+  Array a(10, 1);
+  a.set(9, 2);
+  EXPECT_EQ(1u, a.getNumAllocatedPages());
+  EXPECT_EQ(2, a[9]);
+  EXPECT_EQ(1, a[8]);
+
+  Array b(a);
+  b.set(8, 3);
+  EXPECT_EQ(1, a[8]);
+  EXPECT_EQ(3, b[8]);
+  EXPECT_EQ(2, b[9]);
+}
+
+TEST(PagedArrayTest, CopyOutAcrossPages) {
+  Array a(10, 1);
+  a.set(3, 30);
+  a.set(4, 40);
+  a.set(9, 90);
+
+  int expected[10] = { 1, 1, 1, 30, 40, 1, 1, 1, 1, 90 };
+  EXPECT_EQ(std::vector<int>(expected, expected + 10), contents(a));
+}
+
+TEST(PagedArrayTest, CopyInAcrossPages) {
+  Array a(10);
+  int src[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  a.copyIn(src);
+  EXPECT_EQ(std::vector<int>(src, src + 10), contents(a));
+  EXPECT_TRUE(a.equals(src));
+
+  // Pages that copyIn does not change stay shared.
+  Array b(a);
+  src[4] = 40;
+  b.copyIn(src);
+  EXPECT_EQ(std::vector<int>(src, src + 10), contents(b));
+  EXPECT_EQ(4, a[4]);
+  EXPECT_TRUE(a.sharesPage(b, 0));
+  EXPECT_FALSE(a.sharesPage(b, 4));
+  EXPECT_TRUE(a.sharesPage(b, 8));
+}
+
+TEST(PagedArrayTest, EqualsAcrossPages) {
+  Array a(10);
+  for (unsigned i = 0; i < 10; i++)
+    a.set(i, i);
+  int src[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  EXPECT_TRUE(a.equals(src));
+
+  // A difference on either side of a page boundary, and in the last page.
+  src[3] = -1;
+  EXPECT_FALSE(a.equals(src));
+  src[3] = 3;
+  src[4] = -1;
+  EXPECT_FALSE(a.equals(src));
+  src[4] = 4;
+  src[9] = -1;
+  EXPECT_FALSE(a.equals(src));
+}
+
+TEST(PagedArrayTest, FillThenCopy) {
+  Array a(10);
+  a.set(5, 5);
+  a.fill(3);
+  EXPECT_EQ(0u, a.getNumAllocatedPages());
+
+  Array b(a);
+  EXPECT_EQ(0u, b.getNumAllocatedPages());
+  for (unsigned i = 0; i < 10; i++)
+    EXPECT_EQ(3, b[i]);
+
+  // Pages allocated after the fill start from the filled value.
+  b.set(5, 6);
+  EXPECT_EQ(1u, b.getNumAllocatedPages());
+  EXPECT_EQ(3, b[4]);
+  EXPECT_EQ(6, b[5]);
+  EXPECT_EQ(3, a[5]);
+}
+
+TEST(PagedArrayTest, CopyInNullPages) {
+  Array a(10, 1);
+  int src[10] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+  // Contents equal to the initial value leave the pages unallocated.
+  a.copyIn(src);
+  EXPECT_EQ(0u, a.getNumAllocatedPages());
+  EXPECT_TRUE(a.equals(src));
+
+  src[9] = 2;
+  EXPECT_FALSE(a.equals(src));
+  a.copyIn(src);
+  EXPECT_EQ(1u, a.getNumAllocatedPages());
+  EXPECT_EQ(std::vector<int>(src, src + 10), contents(a));
+}
+
+TEST(PagedArrayTest, ResetNullPage) {
+  Array a(10);
+  a.reset(5);
+  EXPECT_EQ(0u, a.getNumAllocatedPages());
+
+  a.set(5, 5);
+  Array b(a);
+  b.reset(5);
+  EXPECT_EQ(0, b[5]);
+  EXPECT_EQ(5, a[5]);
+  EXPECT_FALSE(a.sharesPage(b, 5));
+}
+
+}
@@ -0,0 +1,64 @@
+//===-- SpillArenaTest.cpp --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/System/SpillArena.h"
+
+#include <cstring>
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+// The arena is global and cannot be disabled again, so the test without it
+// has to come first.
+TEST(SpillArenaTest, HeapWithoutArena) {
+  void *p = util::AllocateSpillable(8192);
+  ASSERT_TRUE(p != 0);
+  memset(p, 1, 8192);
+  EXPECT_EQ(0u, util::GetSpillArenaUsage());
+  util::FreeSpillable(p, 8192);
+}
+
+TEST(SpillArenaTest, Arena) {
+  std::string error;
+  ASSERT_TRUE(util::EnableSpillArena("/tmp", error)) << error;
+
+  // Small blocks stay on the heap.
+  void *small = util::AllocateSpillable(512);
+  EXPECT_EQ(0u, util::GetSpillArenaUsage());
+  util::FreeSpillable(small, 512);
+
+  void *a = util::AllocateSpillable(4100);
+  void *b = util::AllocateSpillable(4100);
+  ASSERT_TRUE(a != 0 && b != 0);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(0u, (size_t) a % 64);
+  size_t usage = util::GetSpillArenaUsage();
+  EXPECT_GE(usage, 2 * 4100u);
+  memset(a, 1, 4100);
+  memset(b, 2, 4100);
+  EXPECT_GT(util::GetSpillArenaResidentUsage(), 0u);
+
+  // A freed block is handed out again for the same size.
+  util::FreeSpillable(a, 4100);
+  EXPECT_LT(util::GetSpillArenaUsage(), usage);
+  void *c = util::AllocateSpillable(4100);
+  EXPECT_EQ(a, c);
+  EXPECT_EQ(usage, util::GetSpillArenaUsage());
+  EXPECT_EQ(2, ((char *) b)[4099]);
+
+  util::FreeSpillable(b, 4100);
+  util::FreeSpillable(c, 4100);
+  EXPECT_EQ(0u, util::GetSpillArenaUsage());
+}
+
+}